@@ -9,29 +9,48 @@
 #include "random.h"
 #include "max.h"
 #include "agent.h"
+#include "strategy.h"
 
-#define BONUS 0.00
+// reward: monetary reward for a deal; ZI-U traders ignore their limits, so theirs can be a loss
+Real reward(Agent *a, Cents price) {
+    Real r;
+    if ((a->job) == SELL) { r = ((PRICE(price) - PRICE(a->limit))); }
+    else { r = ((PRICE(a->limit) - PRICE(price))); }
 
-#define MARKUP 1.1
-#define MARKDOWN 0.9
-#define MARK 0.05
+    if ((r < 0.0) && (a->strat != ST_ZIU)) r = 0.0;
+
+    return (r);
+}
+
+Zip_params zip_defaults = {MARK, MARK_ABS, 0.05, 0.3, 0.1, 0.4, 0.1};
+
+static _Thread_local Zip_params *zip_params = &zip_defaults; /*this thread's learning parameters*/
+
+// zip-set-params: use these learning parameters for the agents this thread initialises and updates,
+// or the defaults if zp is NULL
+void zip_set_params(Zip_params *zp) {
+    zip_params = (zp == NULL ? &zip_defaults : zp);
+}
+
+// zip-get-params: the learning parameters this thread is using
+Zip_params *zip_get_params(void) {
+    return (zip_params);
+}
 
 // set-price: set the price of an agent from its limit and profit values
 void set_price(Agent *a) {
-    a->price = (a->limit) * (1 + a->profit);
-    /*normalise to one-cent precision*/
-    a->price = (floor((a->price * 100) + 0.5)) / 100;
+    a->price = CENTS(PRICE(a->limit) * (1 + a->profit)); /*to one-cent precision*/
 }
 
 // agent-init: initialise the common elements of an agent (buyer or seller)
 void agent_init(Agent *a, int verbose) {
-    a->beta = 0.1 + randval(0.4);
+    a->beta = zip_params->beta_min + randval_c(RS_INIT, zip_params->beta_range);
     a->bank = 0.0;
     a->n = 0;
     a->sum = 0.0;
     a->last_d = 0.0;
-    a->momntm = 0.2 + randval(0.6);
-    a->momntm = randval(0.1);
+    a->momntm = 0.2 + randval_c(RS_INIT, 0.6); /*overwritten, but the draw keeps the random stream as it always was*/
+    a->momntm = randval_c(RS_INIT, zip_params->mom_range);
     a->active = 1;
     if (verbose) {
         fprintf(stdout, "prof=%+5.3f beta=%5.3f mom=%5.3f bank=%5.2f\n",
@@ -45,7 +64,7 @@ void buy_init(Agent b[MAX_AGENTS], int verbose) {
 
     for (a = 0; a < MAX_AGENTS; a++) {
         b[a].job = BUY;
-        b[a].profit = -1.0 * (0.05 + randval(0.3));
+        b[a].profit = -1.0 * (zip_params->profit_min + randval_c(RS_INIT, zip_params->profit_range));
         if (verbose) fprintf(stdout, "B%2d ", a);
         agent_init(b + a, verbose);
     }
@@ -57,14 +76,14 @@ void sell_init(Agent s[MAX_AGENTS], int verbose) {
 
     for (a = 0; a < MAX_AGENTS; a++) {
         s[a].job = SELL;
-        s[a].profit = 0.05 + randval(0.3);
+        s[a].profit = zip_params->profit_min + randval_c(RS_INIT, zip_params->profit_range);
         if (verbose) fprintf(stdout, "S%2d ", a);
         agent_init(s + a, verbose);
     }
 }
 
 // willing-trade: is an agent willing to trade at given price?
-int willing_trade(Agent *a, Real price) {
+int willing_trade(Agent *a, Cents price) {
     if (a->job == BUY) { /*willing to buy at this price?*/
         if ((a->active) && (a->price >= price)) { a->willing = 1; }
         else { a->willing = 0; }
@@ -77,14 +96,14 @@ int willing_trade(Agent *a, Real price) {
 
 // profit-alter: update profit margin on basis of sale price using Widrow-Hoff style update with learning rate .
 void profit_alter(Agent *a, Real price, int verbose) {
-    Real c, diff, change, newprofit;
+    Areal diff, change, newprofit;
 
     if (verbose)
         fprintf(stdout, "lim=%5.3f prof=%5.3f price=%5.2f",
-                a->limit, a->profit, a->price);
+                PRICE(a->limit), a->profit, PRICE(a->price));
 
-    diff = (price - (a->price));
-    change = ((1.0 - (a->momntm)) * (a->beta) * diff) + ((a->momntm) * (a->last_d));
+    diff = (price - PRICE(a->price));
+    change = (((Areal) 1.0 - (a->momntm)) * (a->beta) * diff) + ((a->momntm) * (a->last_d));
 
     if (verbose)
         fprintf(stdout, " last_d=%5.3f diff=%5.2f chng=%+5.3f",
@@ -93,7 +112,7 @@ void profit_alter(Agent *a, Real price, int verbose) {
     a->last_d = change;
 
     /*set new prices by altering profit margin*/
-    newprofit = ((a->price + change) / a->limit) - 1.0;
+    newprofit = ((((Areal) PRICE(a->price)) + change) / ((Areal) PRICE(a->limit))) - (Areal) 1.0;
 
     if (a->job == SELL) {
         if (newprofit > 0.0) a->profit = newprofit;
@@ -102,72 +121,124 @@ void profit_alter(Agent *a, Real price, int verbose) {
     }
 
     set_price(a);
-    if (verbose) { fprintf(stdout, " nu_prof=%5.3f nu_price=%5.2f", a->profit, a->price); }
+    if (verbose) { fprintf(stdout, " nu_prof=%5.3f nu_price=%5.2f", a->profit, PRICE(a->price)); }
 }
 
-// shout-update: update strategies of buyers and sellers after a shout
-void shout_update(int deal_type, int status, int n_sell,
-                  Agent sellers[], int n_buy, Agent buyers[], Real price,
-                  int verbose) {
-    int b, s;
+// Target prices are drawn from ran1, unless the thread doing the update has set a shout key with
+// zip_keyed(). Then each agent draws from its own stream, keyed by (experiment, shout, agent), so what
+// it draws doesn't depend on which thread updates it or on how many other agents drew before it.
+static _Thread_local Shout_key *shout_key = NULL; /*the shout being updated after, if keyed*/
+static _Thread_local Rkey agent_key;              /*the stream of the agent being updated*/
+
+// zip-keyed: draw this thread's target prices from per-agent keyed streams for the shout key, or
+// from ran1 again if key is NULL
+void zip_keyed(Shout_key *key) {
+    shout_key = key;
+}
+
+// zip-rand: a random value in 0..limit for the agent being updated
+static inline Real zip_rand(Real limit) {
+    if (shout_key != NULL) return (randval_k(&agent_key, limit));
+    return (randval(limit));
+}
+
+// target-up: a target price a little above a deal or shout price (the relative and absolute
+// perturbations are drawn in that order, which the lock-step engine in lockstep.c relies on)
+static Real target_up(Real price) {
+    Real r;
+
+    r = zip_rand(zip_params->mark);
+    return ((price * (1.0 + r)) + zip_rand(zip_params->mark_abs));
+}
+
+// target-down: a target price a little below a deal or shout price
+static Real target_down(Real price) {
+    Real r;
+
+    r = zip_rand(zip_params->mark);
+    return ((price * (1.0 - r)) - zip_rand(zip_params->mark_abs));
+}
+
+// zip-update: update the strategies of a batch of n agents, all on the same side of the market (job),
+// after a shout. base is the index of agents[0] in its side's array, for labelling verbose output.
+void zip_update(int job, int deal_type, int status, Agent agents[], int n, int base, Cents price,
+                int verbose) {
+    int a;
     Real target_price;
-    /*any seller whose price is less than or equal to the deal price raises profit margin*/
-    /*(this is an attempt to increase profits next time around)*/
-
-    for (s = 0; s < n_sell; s++) {
-        if (verbose) fprintf(stdout, "S%02d(%d) ", s, sellers[s].active);
-
-        if (status == DEAL) {
-            if (sellers[s].price <= price) { /*could get more? { try raising margin*/
-                target_price = (price * (1.0 + randval(MARK))) + randval(0.05);
-                profit_alter(sellers + s, target_price, verbose);
-            } else { /*wouldn't have got this deal, so mark the price down*/
-                if ((deal_type == BID) &&
-                    (!willing_trade(sellers + s, price)) &&
-                    (sellers[s].active)
-                        ) {
-                    target_price = (price * (1.0 - randval(MARK))) - randval(0.05);
-                    profit_alter(sellers + s, target_price, verbose);
-                }
+
+    if (job == SELL) {
+        /*any seller whose price is less than or equal to the deal price raises profit margin*/
+        /*(this is an attempt to increase profits next time around)*/
+        for (a = 0; a < n; a++) {
+            if (verbose) fprintf(stdout, "S%02d(%d) ", base + a, agents[a].active);
+            if (shout_key != NULL) {
+                rkey_init(&agent_key, shout_key->exp, shout_key->shout, 2 * (base + a) + SELL);
+                agent_key.anti = shout_key->anti;
             }
-        } else /*NO DEAL*/
-        {
-            if (deal_type == OFFER)
-                if ((sellers[s].price >= price) &&
-                    (sellers[s].active)) { /*would have asked for more and lost the deal, so reduce profit*/
-                    target_price = (price * (1.0 - randval(MARK))) - randval(0.05);
-                    profit_alter(sellers + s, target_price, verbose);
+
+            if (status == DEAL) {
+                if (agents[a].price <= price) { /*could get more? { try raising margin*/
+                    target_price = target_up(PRICE(price));
+                    profit_alter(agents + a, target_price, verbose);
+                } else { /*wouldn't have got this deal, so mark the price down*/
+                    if ((deal_type == BID) &&
+                        (!willing_trade(agents + a, price)) &&
+                        (agents[a].active)
+                            ) {
+                        target_price = target_down(PRICE(price));
+                        profit_alter(agents + a, target_price, verbose);
+                    }
                 }
+            } else /*NO DEAL*/
+            {
+                if (deal_type == OFFER)
+                    if ((agents[a].price >= price) &&
+                        (agents[a].active)) { /*would have asked for more and lost the deal, so reduce profit*/
+                        target_price = target_down(PRICE(price));
+                        profit_alter(agents + a, target_price, verbose);
+                    }
+            }
+            if (verbose)fprintf(stdout, "\n");
         }
-        if (verbose)fprintf(stdout, "\n");
-    }
+    } else {
+        for (a = 0; a < n; a++) {
+            if (verbose) fprintf(stdout, "B%02d(%d) ", base + a, agents[a].active);
+            if (shout_key != NULL) {
+                rkey_init(&agent_key, shout_key->exp, shout_key->shout, 2 * (base + a) + BUY);
+                agent_key.anti = shout_key->anti;
+            }
 
-    for (b = 0; b < n_buy; b++) {
-        if (verbose) fprintf(stdout, "B%02d(%d) ", b, buyers[b].active);
-
-        if (status == DEAL) {
-            if (buyers[b].price >= price) { /*could get lower price? { try raising margin (i.e. cutting price)*/
-                target_price = (price * (1.0 - randval(MARK))) - randval(0.05);
-                profit_alter(buyers + b, target_price, verbose);
-            } else { /*wouldn't have got this deal, so mark the price up (reduce profit)*/
-                if ((deal_type == OFFER) &&
-                    (!willing_trade(buyers + b, price)) &&
-                    (buyers[b].active)
-                        ) {
-                    target_price = (price * (1.0 + randval(MARK))) + randval(0.05);
-                    profit_alter(buyers + b, target_price, verbose);
+            if (status == DEAL) {
+                if (agents[a].price >= price) { /*could get lower price? { try raising margin (i.e. cutting price)*/
+                    target_price = target_down(PRICE(price));
+                    profit_alter(agents + a, target_price, verbose);
+                } else { /*wouldn't have got this deal, so mark the price up (reduce profit)*/
+                    if ((deal_type == OFFER) &&
+                        (!willing_trade(agents + a, price)) &&
+                        (agents[a].active)
+                            ) {
+                        target_price = target_up(PRICE(price));
+                        profit_alter(agents + a, target_price, verbose);
+                    }
                 }
+            } else /*NO-DEAL*/
+            {
+                if (deal_type == BID)
+                    if ((agents[a].price <= price) &&
+                        (agents[a].active)) { /*would have bid less and also lost the deal, so reduce profit*/
+                        target_price = target_up(PRICE(price));
+                        profit_alter(agents + a, target_price, verbose);
+                    }
             }
-        } else /*NO-DEAL*/
-        {
-            if (deal_type == BID)
-                if ((buyers[b].price <= price) &&
-                    (buyers[b].active)) { /*would have bid less and also lost the deal, so reduce profit*/
-                    target_price = (price * (1.0 + randval(MARK))) + randval(0.05);
-                    profit_alter(buyers + b, target_price, verbose);
-                }
+            if (verbose)fprintf(stdout, "\n");
         }
-        if (verbose)fprintf(stdout, "\n");
     }
 }
 
+// shout-update: update strategies of buyers and sellers after a shout
+void shout_update(int deal_type, int status, int n_sell,
+                  Agent sellers[], int n_buy, Agent buyers[], Cents price,
+                  int verbose) {
+    zip_update(SELL, deal_type, status, sellers, n_sell, 0, price, verbose);
+    zip_update(BUY, deal_type, status, buyers, n_buy, 0, price, verbose);
+}
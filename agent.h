@@ -5,6 +5,13 @@
 //
 #define NULL_EQ -1 /*signals no equilibrium*/
 
+// ZIP learning constants
+#define BONUS 0.00
+#define MARKUP 1.1
+#define MARKDOWN 0.9
+#define MARK 0.05     /*default maximum relative perturbation of a target price*/
+#define MARK_ABS 0.05 /*default maximum absolute perturbation of a target price*/
+
 // symbolic constants for agent type, shout type, and whether shout is accepted or rejected
 #define   BUY 1
 #define   SELL 0
@@ -14,18 +21,39 @@
 #define   NO_DEAL 0
 #define   END_DAY 2
 
+// Cents: a price in whole cents. Limits, quotes and deal prices are kept as Cents, so comparing two prices is
+// exact; margins, learning state and the statistics stay Real, and PRICE() gives a price as the Real it has
+// always been (c/100, not c*0.01, which can differ in the last place)
+typedef int Cents;
+
+#define CENTS(x) ((Cents) floor(((x) * 100) + 0.5)) /*round a Real price to the nearest cent*/
+#define PRICE(c) (((Real) (c)) / 100)
+#define PRICE_MAX 100000.0 /*highest limit price an experiment may give: far enough below INT_MAX cents that quotes
+                              marked up from it are whole Cents too*/
+
+// Areal: the ZIP traders' learning state (margin, learning rate, momentum and last change) and the arithmetic
+// that updates it. Real, unless built with -DAGENT_FLOAT (make smith32), which makes it float: half the
+// footprint and twice the vector width for big populations, at the price of results that drift a little from
+// the double build's; smith drift measures how far
+#ifdef AGENT_FLOAT
+typedef float Areal;
+#else
+typedef Real Areal;
+#endif
+
 typedef struct an_agent {
     int job;     /*BUYing or SELLing*/
     int active;  /*still in the market?*/
     int n;       /*number of deals done*/
     int willing; /*want to make a trade at this price?*/
     int able;    /*allowed to trade at this price?*/
-    Real limit;   /*the bottom-line price for this agent*/
-    Real profit;  /*profit coefficient in determinining bid/offer price*/
-    Real beta;    /*coefficient for changing profit over time (learning rate)*/
-    Real momntm;  /*momentum in changing profit*/
-    Real last_d;  /*last change*/
-    Real price;   /*what the agent will actually bid*/
+    int strat;   /*what kind of trader: index into strategies[]*/
+    Cents limit;  /*the bottom-line price for this agent*/
+    Areal profit; /*profit coefficient in determinining bid/offer price*/
+    Areal beta;   /*coefficient for changing profit over time (learning rate)*/
+    Areal momntm; /*momentum in changing profit*/
+    Areal last_d; /*last change*/
+    Cents price;  /*what the agent will actually bid*/
     Real quant;   /*how much of this commodity*/
     Real bank;    /*how much money this agent has in the bank*/
     Real a_gain;  /*actual gain*/
@@ -34,17 +62,47 @@ typedef struct an_agent {
     Real avg;     /*average reward*/
 } Agent;
 
+// Shout-key: which shout of which experiment an update follows, for keying the agents' random streams
+typedef struct a_shout_key {
+    int exp;    /*experiment number*/
+    long shout; /*shouts so far in the experiment*/
+    int anti;   /*boolean: draw antithetic values (see randval_k())?*/
+} Shout_key;
+
+// Zip-params: the ZIP traders' learning parameters, which a sweep can vary; zip_defaults holds the
+// values smith has always used
+typedef struct a_zip_params {
+    Real mark;                     /*maximum relative perturbation of a target price*/
+    Real mark_abs;                 /*maximum absolute perturbation of a target price*/
+    Real profit_min, profit_range; /*initial profit margins are drawn from [min, min+range]*/
+    Real beta_min, beta_range;     /*learning rates are drawn from [min, min+range]*/
+    Real mom_range;                /*momentum is drawn from [0, range]*/
+} Zip_params;
+
+extern Zip_params zip_defaults;
+
+Real reward(Agent *, Cents);
+
 void set_price(Agent *);
 
 void shout_update(int deal_type, int status,
-                  int n_sell, Agent sellers[], int n_buy, Agent buyers[], Real price,
+                  int n_sell, Agent sellers[], int n_buy, Agent buyers[], Cents price,
                   int verbose);
 
+void zip_update(int job, int deal_type, int status, Agent agents[], int n, int base, Cents price,
+                int verbose);
+
+void zip_keyed(Shout_key *key);
+
+void zip_set_params(Zip_params *zp);
+
+Zip_params *zip_get_params(void);
+
 void buy_init(Agent b[], int verbose);
 
 void sell_init(Agent s[], int verbose);
 
-int willing_trade(Agent *a, Real price);
+int willing_trade(Agent *a, Cents price);
 
 void profit_alter(Agent *a, Real price, int verbose);
 
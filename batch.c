@@ -0,0 +1,110 @@
+//
+// batch.c: share a batch of configurations' experiments out over the thread pool (see batch.h)
+//
+// A day needs the traders as the day before left them, so an experiment's days run in order on one
+// thread; the costliest configurations go first so that their long experiments start early and the
+// short ones fill in around them.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "ddat.h"
+#include "tdat.h"
+#include "expctl.h"
+#include "strategy.h"
+#include "book.h"
+#include "market.h"
+#include "pool.h"
+#include "batch.h"
+
+// Ba-run: a batch in progress, shared by the threads running its jobs
+typedef struct ba_run {
+    int n, n_exps;
+    long *cost;              /*estimated cost of each configuration*/
+    int *order;              /*configurations, costliest first*/
+    Exp_result **res;        /*each configuration's experiments' results, until they are folded*/
+    atomic_int *left;        /*experiments of each configuration still to finish*/
+    pthread_mutex_t lock;    /*guards the allocation of res[]*/
+    Batch_setup setup;
+    Batch_fold fold;
+    void *arg;
+} Ba_run;
+
+// ba-job: run job j, an experiment of one configuration; the thread that finishes a configuration's last
+// experiment folds it
+static void ba_job(void *arg, int j, int n) {
+    Ba_run *run = arg;
+    Market *m;
+    int k, e;
+
+    k = run->order[j / run->n_exps];
+    e = j % run->n_exps;
+    m = run->setup(run->arg, k);
+
+    pthread_mutex_lock(&(run->lock));
+    if (run->res[k] == NULL) {
+        if ((run->res[k] = malloc(run->n_exps * sizeof(Exp_result))) == NULL) {
+            fprintf(stderr, "\nFail: can't allocate results for configuration %d of a batch\n", k);
+            exit(0);
+        }
+    }
+    pthread_mutex_unlock(&(run->lock));
+
+    market_exp(m, e, run->n_exps, run->res[k] + e);
+
+    if (atomic_fetch_sub(run->left + k, 1) == 1) {
+        run->fold(run->arg, k, m, run->res[k]);
+        free(run->res[k]);
+        run->res[k] = NULL;
+    }
+}
+
+// Ba-cost-cmp: order configurations by decreasing cost, then by index
+static Ba_run *ba_sorting;
+
+static int ba_cost_cmp(const void *x, const void *y) {
+    int a = *(const int *) x, b = *(const int *) y;
+
+    if (ba_sorting->cost[a] != ba_sorting->cost[b]) return (ba_sorting->cost[a] > ba_sorting->cost[b] ? -1 : 1);
+    return (a - b);
+}
+
+// batch-run: run n_exps experiments of each of n configurations, costing cost[k] each, over the thread
+// pool, folding each configuration's results as soon as they are all in
+void batch_run(int n, int n_exps, long cost[], Batch_setup setup, Batch_fold fold, void *arg) {
+    Ba_run run;
+    int k;
+
+    run.n = n;
+    run.n_exps = n_exps;
+    run.cost = cost;
+    run.setup = setup;
+    run.fold = fold;
+    run.arg = arg;
+    run.order = malloc(n * sizeof(int));
+    run.res = calloc(n, sizeof(Exp_result *));
+    run.left = malloc(n * sizeof(atomic_int));
+    if ((run.order == NULL) || (run.res == NULL) || (run.left == NULL)) {
+        fprintf(stderr, "\nFail: can't allocate a batch of %d configurations\n", n);
+        exit(0);
+    }
+    pthread_mutex_init(&(run.lock), NULL);
+    for (k = 0; k < n; k++) {
+        run.order[k] = k;
+        atomic_init(run.left + k, n_exps);
+    }
+    ba_sorting = &run;
+    qsort(run.order, n, sizeof(int), ba_cost_cmp);
+
+    pool_each(ba_job, &run, n * n_exps);
+
+    pthread_mutex_destroy(&(run.lock));
+    free(run.order);
+    free(run.res);
+    free(run.left);
+}
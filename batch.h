@@ -0,0 +1,16 @@
+//
+// batch.h: run n_exps experiments of each of many configurations of a market over the thread pool
+//
+// Every (configuration, experiment) pair is a job. The jobs are handed to the pool costliest
+// configuration first, each thread taking the next job whenever it finishes one, and a configuration's
+// results are handed back in experiment order once the last of them is done, so what is made of them
+// doesn't depend on the number of threads. A sweep's points and a manifest's markets are batches.
+
+// Batch-setup: set this thread's market up for configuration k, and return it
+typedef Market *(*Batch_setup)(void *arg, int k);
+
+// Batch-fold: take the results of configuration k's experiments, in experiment order, on the thread that
+// ran its last one, with that thread's market as batch_setup() left it
+typedef void (*Batch_fold)(void *arg, int k, Market *, Exp_result []);
+
+void batch_run(int n, int n_exps, long cost[], Batch_setup, Batch_fold, void *arg);
@@ -0,0 +1,117 @@
+//
+// book.c: a limit order book over the cent grid (see book.h)
+//
+
+#include <string.h>
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "book.h"
+
+// bk-scan: the best level with orders on a side, looking from level from away from the spread; -1 if none
+static Cents bk_scan(Book_side *sd, Cents from) {
+    int w = from / 64;
+    unsigned long long bits;
+
+    if (sd->job == SELL) { /*the asks: upwards*/
+        bits = sd->live[w] & (~0ULL << (from % 64));
+        while (bits == 0) {
+            if (++w == BOOK_WORDS) return (-1);
+            bits = sd->live[w];
+        }
+        return ((w * 64) + __builtin_ctzll(bits));
+    }
+    bits = sd->live[w] & (~0ULL >> (63 - (from % 64))); /*the bids: downwards*/
+    while (bits == 0) {
+        if (--w < 0) return (-1);
+        bits = sd->live[w];
+    }
+    return ((w * 64) + 63 - __builtin_clzll(bits));
+}
+
+// bk-side-clear: empty one side of the book
+static void bk_side_clear(Book_side *sd, int job) {
+    sd->job = job;
+    sd->n = 0;
+    sd->best = -1;
+    memset(sd->head, 0xff, sizeof(sd->head)); /*all -1*/
+    memset(sd->tail, 0xff, sizeof(sd->tail));
+    memset(sd->live, 0, sizeof(sd->live));
+    memset(sd->price, 0xff, sizeof(sd->price));
+}
+
+// book-clear: empty the book, as at the start of a day
+void book_clear(Order_book *ob) {
+    bk_side_clear(&(ob->bids), BUY);
+    bk_side_clear(&(ob->asks), SELL);
+    ob->open = 0;
+    ob->n_fills = ob->next_fill = 0;
+}
+
+// book-cancel: take trader a's order, if any, off one side of the book
+void book_cancel(Book_side *sd, int a) {
+    Cents p = sd->price[a];
+
+    if (p < 0) return;
+    if (sd->prev[a] >= 0) sd->next[sd->prev[a]] = sd->next[a];
+    else sd->head[p] = sd->next[a];
+    if (sd->next[a] >= 0) sd->prev[sd->next[a]] = sd->prev[a];
+    else sd->tail[p] = sd->prev[a];
+    sd->price[a] = -1;
+    (sd->n)--;
+
+    if (sd->head[p] < 0) { /*the level is empty*/
+        sd->live[p / 64] &= ~(1ULL << (p % 64));
+        if (sd->best == p) sd->best = bk_scan(sd, p);
+    }
+}
+
+// book-rest: queue trader a's order for qty units at price behind the others at that level, the trader
+// having none resting; returns 0 if the price is off the grid
+int book_rest(Book_side *sd, int a, Cents price, int qty) {
+    if ((price < 0) || (price >= BOOK_TICKS)) return (0);
+
+    sd->price[a] = price;
+    sd->qty[a] = qty;
+    sd->next[a] = -1;
+    sd->prev[a] = sd->tail[price];
+    if (sd->tail[price] >= 0) sd->next[sd->tail[price]] = a;
+    else {
+        sd->head[price] = a;
+        sd->live[price / 64] |= 1ULL << (price % 64);
+    }
+    sd->tail[price] = a;
+    (sd->n)++;
+
+    if ((sd->best < 0) || ((sd->job == SELL) ? (price < sd->best) : (price > sd->best))) sd->best = price;
+    return (1);
+}
+
+// book-order: trader a on side job orders qty units at price, in place of its order resting, if any.
+// The order fills what it can against the other side, leaving the fills in ob->fill[], and the rest of
+// it rests; returns the number of fills, or -1 if the price is off the grid and the order is refused.
+int book_order(Order_book *ob, int job, int a, Cents price, int qty) {
+    int o;
+    Book_side *own, *opp;
+    Fill *f;
+
+    own = (job == SELL ? &(ob->asks) : &(ob->bids));
+    opp = (job == SELL ? &(ob->bids) : &(ob->asks));
+    ob->n_fills = ob->next_fill = 0;
+    book_cancel(own, a);
+    if ((price < 0) || (price >= BOOK_TICKS)) return (-1);
+    if (qty > MAX_UNITS) qty = MAX_UNITS;
+
+    while ((qty > 0) && (opp->best >= 0) && ((job == SELL) ? (opp->best >= price) : (opp->best <= price))) {
+        o = opp->head[opp->best]; /*price, then time*/
+        f = ob->fill + (ob->n_fills)++;
+        f->s = (job == SELL ? a : o);
+        f->b = (job == SELL ? o : a);
+        f->price = opp->best;
+        qty--;
+        if (--(opp->qty[o]) == 0) book_cancel(opp, o);
+    }
+    if (qty > 0) book_rest(own, a, price, qty);
+    return (ob->n_fills);
+}
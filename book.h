@@ -0,0 +1,51 @@
+//
+// book.h: a limit order book over the cent grid, for the order-book market rules (RULES_BOOK)
+//
+// Each side of the book is an array of price levels, one per cent from 0 to BOOK_TICKS-1, each a queue of
+// orders, oldest first, linked through the orders themselves, with a bitmap of the levels that hold any
+// order. A trader has at most one order resting, kept in slot a of its side for trader a, so adding,
+// cancelling and filling an order are O(1), and the next best level, when the best empties, is found a
+// word of the bitmap at a time. An incoming order is matched by price, then time: it takes units from the
+// oldest order at the best opposite level, at that order's price, for as long as the prices cross, and
+// whatever it doesn't fill rests. A trader with several units orders them all at once, and its order is
+// filled a unit at a time, by as many incoming orders as it takes.
+
+#ifndef BOOK_TICKS
+#define BOOK_TICKS 1024 /*orders can be priced from 0 to BOOK_TICKS-1 cents*/
+#endif
+#define BOOK_WORDS ((BOOK_TICKS + 63) / 64)
+
+// Book-side: the bids or the asks
+typedef struct a_book_side {
+    int job;                                 /*BUY: the bids, best highest; SELL: the asks, best lowest*/
+    int n;                                   /*orders resting*/
+    Cents best;                              /*the best level with orders: -1 if none*/
+    int head[BOOK_TICKS], tail[BOOK_TICKS];  /*each level's oldest and newest order: -1 if none*/
+    unsigned long long live[BOOK_WORDS];     /*bit p set => level p has orders*/
+    int next[MAX_AGENTS], prev[MAX_AGENTS];  /*trader a's order's neighbours in its level's queue*/
+    Cents price[MAX_AGENTS];                 /*trader a's order's price: -1 if it has none resting*/
+    int qty[MAX_AGENTS];                     /*units it has still to deal*/
+} Book_side;
+
+// Fill: one unit dealt between a resting order and an incoming one
+typedef struct a_fill {
+    int s, b;                                /*seller and buyer*/
+    Cents price;                             /*the resting order's price*/
+} Fill;
+
+// Order-book: both sides of the book, and the fills of the last incoming order not yet dealt
+typedef struct an_order_book {
+    Book_side bids, asks;
+    int open;                                /*boolean: have today's orders from silent traders been placed?*/
+    int n_fills, next_fill;
+    Fill fill[MAX_UNITS];                    /*an order for n units fills at most n*/
+    int dt;                                  /*the deal type of the order that made them: BID or OFFER*/
+} Order_book;
+
+void book_clear(Order_book *);
+
+void book_cancel(Book_side *, int);
+
+int book_rest(Book_side *, int, Cents, int);
+
+int book_order(Order_book *, int job, int, Cents, int);
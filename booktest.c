@@ -0,0 +1,91 @@
+//
+// booktest.c: check the limit order book of book.c: price-time priority, cancel-on-replace, partial fills of
+// multi-unit orders and the bitmap's search for the next best level. Run by "make check"
+//
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "book.h"
+
+static Order_book ob; /*static: too big for the stack*/
+
+// bt-fill: check fill k of the last order
+static void bt_fill(int k, int s, int b, Cents price) {
+    assert(k < ob.n_fills);
+    assert(ob.fill[k].s == s);
+    assert(ob.fill[k].b == b);
+    assert(ob.fill[k].price == price);
+}
+
+int main(void) {
+    book_clear(&ob);
+
+    /*price, then time: the cheaper level first, and the older order first within a level*/
+    assert(book_order(&ob, SELL, 0, 105, 1) == 0);
+    assert(book_order(&ob, SELL, 1, 100, 1) == 0);
+    assert(book_order(&ob, SELL, 2, 100, 1) == 0);
+    assert((ob.asks.best == 100) && (ob.asks.n == 3));
+    assert(book_order(&ob, BUY, 0, 110, 3) == 3);
+    bt_fill(0, 1, 0, 100);
+    bt_fill(1, 2, 0, 100);
+    bt_fill(2, 0, 0, 105);
+    assert((ob.asks.n == 0) && (ob.asks.best == -1) && (ob.bids.n == 0));
+
+    /*a multi-unit order is filled a unit at a time, and what an order doesn't fill rests*/
+    assert(book_order(&ob, SELL, 3, 200, 3) == 0);
+    assert(book_order(&ob, BUY, 1, 200, 1) == 1);
+    bt_fill(0, 3, 1, 200);
+    assert((ob.asks.qty[3] == 2) && (ob.asks.best == 200));
+    assert(book_order(&ob, BUY, 2, 250, 3) == 2);
+    bt_fill(0, 3, 2, 200);
+    bt_fill(1, 3, 2, 200);
+    assert((ob.asks.n == 0) && (ob.asks.price[3] == -1));
+    assert((ob.bids.best == 250) && (ob.bids.price[2] == 250) && (ob.bids.qty[2] == 1));
+
+    /*an order below the best bid rests behind it, and a sell fills the best first*/
+    assert(book_order(&ob, BUY, 3, 240, 2) == 0);
+    assert(book_order(&ob, SELL, 4, 230, 3) == 3);
+    bt_fill(0, 4, 2, 250);
+    bt_fill(1, 4, 3, 240);
+    bt_fill(2, 4, 3, 240);
+    assert((ob.bids.n == 0) && (ob.bids.best == -1) && (ob.asks.n == 0));
+
+    /*a trader's new order cancels its old one: the old price can no longer be hit*/
+    assert(book_order(&ob, SELL, 5, 300, 1) == 0);
+    assert(book_order(&ob, SELL, 5, 400, 1) == 0);
+    assert((ob.asks.n == 1) && (ob.asks.best == 400) && (ob.asks.head[300] == -1));
+    assert(book_order(&ob, BUY, 4, 350, 1) == 0);
+    assert((ob.bids.best == 350) && (ob.asks.best == 400));
+
+    /*and goes to the back of its level's queue, even at the same price*/
+    assert(book_order(&ob, SELL, 6, 400, 1) == 0);
+    assert(book_order(&ob, SELL, 5, 400, 1) == 0);
+    assert(book_order(&ob, BUY, 5, 400, 1) == 1);
+    bt_fill(0, 6, 5, 400);
+    assert((ob.asks.head[400] == 5) && (ob.asks.n == 1));
+
+    /*the next best level is found across the bitmap's words when the best empties*/
+    book_clear(&ob);
+    assert(book_order(&ob, BUY, 0, 900, 1) == 0);
+    assert(book_order(&ob, BUY, 1, 3, 1) == 0);
+    assert(ob.bids.best == 900);
+    book_cancel(&(ob.bids), 0);
+    assert(ob.bids.best == 3);
+    assert(book_order(&ob, SELL, 0, 0, 2) == 1);
+    bt_fill(0, 0, 1, 3);
+    assert((ob.bids.best == -1) && (ob.asks.best == 0) && (ob.asks.qty[0] == 1));
+
+    /*an order off the grid is refused, and still cancels the trader's old one*/
+    assert(book_order(&ob, SELL, 0, BOOK_TICKS, 1) == -1);
+    assert((ob.asks.n == 0) && (ob.asks.best == -1));
+    assert(book_order(&ob, BUY, 1, -1, 1) == -1);
+    assert(book_order(&ob, BUY, 1, BOOK_TICKS - 1, 1) == 0);
+    assert(ob.bids.best == BOOK_TICKS - 1);
+
+    fprintf(stdout, "book: all checks passed\n");
+    return (0);
+}
@@ -0,0 +1,209 @@
+//
+// cache.c: an on-disk cache of experiments' results (see cache.h)
+//
+// Entries are written to a temporary file and renamed into place, so a reader sees either a whole
+// entry or none, even with several threads or processes sharing the cache.
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "ddat.h"
+#include "tdat.h"
+#include "expctl.h"
+#include "strategy.h"
+#include "book.h"
+#include "market.h"
+#include "cache.h"
+#include "warm.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+// Ckey: the key of a cache entry, as bytes
+typedef struct a_ckey {
+    unsigned char *b;
+    size_t n, size;
+} Ckey;
+
+static char *cache_dir = NULL;
+static atomic_long cache_hits, cache_misses;
+
+// cache-open: use the cache in directory dir, creating it if need be
+void cache_open(char dir[]) {
+    if ((mkdir(dir, 0777) != 0) && (errno != EEXIST)) {
+        fprintf(stderr, "\nFail: can't make cache directory %s\n", dir);
+        exit(0);
+    }
+    cache_dir = dir;
+}
+
+// ck-room: make room in a key for n bytes in all
+static void ck_room(Ckey *k, size_t n) {
+    if (n > k->size) {
+        k->size = 2 * n;
+        if ((k->b = realloc(k->b, k->size)) == NULL) {
+            fprintf(stderr, "\nFail: can't allocate a cache key\n");
+            exit(0);
+        }
+    }
+}
+
+// ck-put: append n bytes to a key
+static void ck_put(Ckey *k, void *p, size_t n) {
+    ck_room(k, k->n + n);
+    memcpy(k->b + k->n, p, n);
+    k->n += n;
+}
+
+// ck-sched: append a schedule to a key
+static void ck_sched(Ckey *k, SD_sched *sched) {
+    int a;
+    Agent_sched *as;
+
+    ck_put(k, &(sched->n_agents), sizeof(int));
+    ck_put(k, &(sched->first_day), sizeof(int));
+    ck_put(k, &(sched->last_day), sizeof(int));
+    ck_put(k, &(sched->can_shout), sizeof(int));
+    for (a = 0; a < sched->n_agents; a++) {
+        as = sched->agents + a;
+        ck_put(k, &(as->n_units), sizeof(int));
+        ck_put(k, as->limit, as->n_units * sizeof(Cents));
+        ck_put(k, &(as->strategy), sizeof(int));
+    }
+}
+
+// ck-make: the key of experiment e on market m, run by traders whose learning state is areal_size bytes wide
+static void ck_make(Ckey *k, Market *m, int e, int areal_size) {
+    int s, v = ENGINE_VERSION,
+            sizes[6] = {sizeof(Real), areal_size, MAX_N_DAYS, MAX_TRADES, MAX_STRAT, BOOK_TICKS};
+    Expctl *ec = &(m->ec);
+
+    k->n = 0;
+    ck_put(k, &v, sizeof(int));
+    ck_put(k, sizes, sizeof(sizes));
+    ck_put(k, &(m->rs), sizeof(int));
+    ck_put(k, &e, sizeof(int));
+    ck_put(k, &(ec->keyed), sizeof(int));
+    ck_put(k, &(m->zp), sizeof(Zip_params));
+    ck_put(k, &(ec->n_days), sizeof(int));
+    ck_put(k, &(ec->min_trades), sizeof(int));
+    ck_put(k, &(ec->max_trades), sizeof(int));
+    ck_put(k, &(ec->random), sizeof(int));
+    ck_put(k, &(ec->nyse), sizeof(int));
+    ck_put(k, &(ec->n_dem_sched), sizeof(int));
+    for (s = 0; s < ec->n_dem_sched; s++) ck_sched(k, ec->dem_sched + s);
+    ck_put(k, &(ec->n_sup_sched), sizeof(int));
+    for (s = 0; s < ec->n_sup_sched; s++) ck_sched(k, ec->sup_sched + s);
+    if (m->crn) { /*which streams the experiment draws from*/
+        ck_put(k, &(m->crn), sizeof(int));
+        ck_put(k, &(m->anti), sizeof(int));
+    }
+    if (m->warm != NULL) { /*the traders' starting state*/
+        ck_put(k, &(m->warm->n_buy), sizeof(int));
+        ck_put(k, &(m->warm->n_sell), sizeof(int));
+        ck_put(k, m->warm->buyers, (m->warm->n_buy + m->warm->n_sell) * sizeof(Warm_agent));
+        ck_put(k, &(m->jitter), sizeof(Real));
+    }
+}
+
+// ck-hash: the FNV-1a hash of a key
+static unsigned long long ck_hash(Ckey *k) {
+    unsigned long long h = FNV_OFFSET;
+    size_t i;
+
+    for (i = 0; i < k->n; i++) h = (h ^ k->b[i]) * FNV_PRIME;
+    return (h);
+}
+
+// ck-path: the file holding the entry for a key
+static void ck_path(char path[], Ckey *k) {
+    sprintf(path, "%s/%016llx.res", cache_dir, ck_hash(k));
+}
+
+// cache-key: the hash of the key of experiment 0 on market m, which is the same for two markets only if
+// they run the same experiments
+unsigned long long cache_key(Market *m) {
+    static _Thread_local Ckey k;
+
+    ck_make(&k, m, 0, sizeof(Areal));
+    return (ck_hash(&k));
+}
+
+// cache-config-key: as cache_key(), but the same for the double and single-precision builds, whose runs of
+// one configuration are compared for drift
+unsigned long long cache_config_key(Market *m) {
+    static _Thread_local Ckey k;
+
+    ck_make(&k, m, 0, 0);
+    return (ck_hash(&k));
+}
+
+// cache-usable: can experiment e of market m be served from the cache or stored in it?
+static int cache_usable(Market *m, int e) {
+    /*the first experiment draws figures, and may save a warm file*/
+    return ((cache_dir != NULL) && m->indep && (!((m->figs || m->warm_day) && (e == 0))));
+}
+
+// cache-get: look experiment e of market m up in the cache; returns 1 and fills r if it is there
+int cache_get(Market *m, int e, Exp_result *r) {
+    static _Thread_local Ckey k, stored;
+    char path[FILENAME_MAX], magic[8];
+    size_t n;
+    FILE *fp;
+    int hit = 0;
+
+    if (!cache_usable(m, e)) return (0);
+    ck_make(&k, m, e, sizeof(Areal));
+    ck_path(path, &k);
+    if ((fp = fopen(path, "rb")) != NULL) {
+        if ((fread(magic, 8, 1, fp) == 1) && (memcmp(magic, CACHE_MAGIC, 8) == 0) &&
+            (fread(&n, sizeof(n), 1, fp) == 1) && (n == k.n)) {
+            ck_room(&stored, n);
+            hit = (fread(stored.b, n, 1, fp) == 1) && (memcmp(stored.b, k.b, n) == 0) &&
+                  (fread(r, sizeof(Exp_result), 1, fp) == 1);
+        }
+        fclose(fp);
+    }
+    if (hit) atomic_fetch_add(&cache_hits, 1);
+    else atomic_fetch_add(&cache_misses, 1);
+    return (hit);
+}
+
+// cache-put: store experiment e of market m's results in the cache
+void cache_put(Market *m, int e, Exp_result *r) {
+    static _Thread_local Ckey k;
+    char path[FILENAME_MAX], tmp[FILENAME_MAX];
+    int fd, ok;
+    FILE *fp;
+
+    if (!cache_usable(m, e)) return;
+    ck_make(&k, m, e, sizeof(Areal));
+    ck_path(path, &k);
+    sprintf(tmp, "%s/tmpXXXXXX", cache_dir);
+    if (((fd = mkstemp(tmp)) < 0) || ((fp = fdopen(fd, "wb")) == NULL)) {
+        fprintf(stderr, "Can't write to cache %s: going without\n", cache_dir);
+        cache_dir = NULL;
+        return;
+    }
+    fwrite(CACHE_MAGIC, 8, 1, fp);
+    fwrite(&(k.n), sizeof(k.n), 1, fp);
+    fwrite(k.b, k.n, 1, fp);
+    fwrite(r, sizeof(Exp_result), 1, fp);
+    ok = (!ferror(fp));
+    if ((fclose(fp) != 0) || (!ok) || (rename(tmp, path) != 0)) unlink(tmp);
+}
+
+// cache-report: say how well the cache did
+void cache_report(void) {
+    if (cache_dir == NULL) return;
+    fprintf(stdout, "cache %s: %ld hits, %ld misses\n", cache_dir, atomic_load(&cache_hits),
+            atomic_load(&cache_misses));
+}
@@ -0,0 +1,23 @@
+//
+// cache.h: an on-disk cache of experiments' results, addressed by what determines them
+//
+// An independently seeded experiment's results depend only on the parsed experiment (its days, trade
+// limits, rules and schedules, but not its id), the ZIP learning parameters, whether agents draw from
+// keyed streams, the run's seed, the experiment's number and the engine itself. Those are written out
+// as a key; its FNV-1a hash names the entry, and the entry holds the whole key so that a hash collision
+// can't serve the wrong results. ENGINE_VERSION is part of every key: bumping it invalidates the cache.
+
+#define ENGINE_VERSION 3 /*bump whenever a change to the engine alters any experiment's results*/
+#define CACHE_MAGIC "ZIPCACH1"
+
+void cache_open(char []);
+
+int cache_get(Market *, int, Exp_result *);
+
+void cache_put(Market *, int, Exp_result *);
+
+void cache_report(void);
+
+unsigned long long cache_key(Market *);
+
+unsigned long long cache_config_key(Market *);
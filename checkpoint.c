@@ -0,0 +1,123 @@
+//
+// checkpoint.c: save a run of experiments between experiments, and take it up again (see checkpoint.h)
+//
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "ddat.h"
+#include "tdat.h"
+#include "expctl.h"
+#include "strategy.h"
+#include "book.h"
+#include "market.h"
+#include "cache.h"
+#include "checkpoint.h"
+
+// ckpt-name: the name of run id's checkpoint file
+void ckpt_name(char fname[], char id[]) {
+    sprintf(fname, "%scheckpoint.dat", id);
+}
+
+// ck-head: fill in a checkpoint header for this build and a run on market m
+static void ck_head(Ckpt_head *h, Market *m, int n_exps, int e_next, int every) {
+    memset(h, 0, sizeof(Ckpt_head));
+    memcpy(h->magic, CKPT_MAGIC, 8);
+    h->version = ENGINE_VERSION;
+    h->real_size = sizeof(Real);
+    h->areal_size = sizeof(Areal);
+    h->market_size = sizeof(Market);
+    h->max_n_days = MAX_N_DAYS;
+    h->max_trades_b = MAX_TRADES;
+    h->max_agents = MAX_AGENTS;
+    h->max_strat = MAX_STRAT;
+    h->n_exps = n_exps;
+    h->e_next = e_next;
+    h->every = every;
+    h->key = cache_key(m);
+}
+
+// ckpt-save: checkpoint a run of n_exps experiments on a market, which has run all those before e_next
+void ckpt_save(char fname[], Market *m, int n_exps, int e_next, int every, Day_data ddat[], Real_stat ats_e[]) {
+    Ckpt_head h;
+    char tmp[FILENAME_MAX];
+    int ok;
+    FILE *fp;
+
+    sprintf(tmp, "%s.tmp", fname);
+    if ((fp = fopen(tmp, "wb")) == NULL) {
+        fprintf(stderr, "\nFail: can't open checkpoint file %s\n", tmp);
+        exit(0);
+    }
+    ck_head(&h, m, n_exps, e_next, every);
+    fwrite(&h, sizeof(h), 1, fp);
+    fwrite(m, sizeof(Market), 1, fp);
+    fwrite(rng_get(), sizeof(Ran1), 1, fp);
+    fwrite(ddat, sizeof(Day_data), MAX_N_DAYS, fp);
+    fwrite(ats_e, sizeof(Real_stat), MAX_TRADES, fp);
+    ok = ((fflush(fp) == 0) && (!ferror(fp)) && (fsync(fileno(fp)) == 0));
+    if ((fclose(fp) != 0) || (!ok) || (rename(tmp, fname) != 0)) {
+        fprintf(stderr, "\nFail: couldn't write checkpoint file %s\n", fname);
+        exit(0);
+    }
+}
+
+// ckpt-load: take up a run of n_exps experiments on a market from its checkpoint; returns the first
+// experiment still to run, or 0 if there is no checkpoint
+int ckpt_load(char fname[], Market *m, int n_exps, int *every, Day_data ddat[], Real_stat ats_e[]) {
+    Ckpt_head h, want;
+    static Market saved;
+    FILE *fp;
+
+    if ((fp = fopen(fname, "rb")) == NULL) {
+        fprintf(stdout, "No checkpoint %s: starting from the first experiment\n", fname);
+        return (0);
+    }
+    ck_head(&want, m, n_exps, 0, 0);
+    if ((fread(&h, sizeof(h), 1, fp) != 1) || (memcmp(&h, &want, offsetof(Ckpt_head, e_next)) != 0)) {
+        fprintf(stderr, "\nFail: %s isn't a checkpoint of %d experiments from this build\n", fname, n_exps);
+        exit(0);
+    }
+    if ((fread(&saved, sizeof(Market), 1, fp) != 1) || (fread(rng_get(), sizeof(Ran1), 1, fp) != 1) ||
+        (fread(ddat, sizeof(Day_data), MAX_N_DAYS, fp) != MAX_N_DAYS) ||
+        (fread(ats_e, sizeof(Real_stat), MAX_TRADES, fp) != MAX_TRADES)) {
+        fprintf(stderr, "\nFail: %s is cut short\n", fname);
+        exit(0);
+    }
+    fclose(fp);
+
+    /*the run must be the same one, as far as the results go*/
+    if ((strcmp(saved.ec.id, m->ec.id) != 0) || (saved.ec.n_days != m->ec.n_days) ||
+        (saved.ec.max_trades != m->ec.max_trades) || (saved.rs != m->rs) || (saved.indep != m->indep) ||
+        (saved.ec.keyed != m->ec.keyed) || (memcmp(&(saved.zp), &(m->zp), sizeof(Zip_params)) != 0) ||
+        ((saved.warm == NULL) != (m->warm == NULL)) || (saved.jitter != m->jitter) || (saved.crn != m->crn) ||
+        (saved.anti != m->anti)) {
+        fprintf(stderr, "\nFail: %s was checkpointed by a different run (check -e, -j, -w, -J, -N and -A)\n",
+                fname);
+        exit(0);
+    }
+    if (h.key != want.key) {
+        fprintf(stderr, "\nFail: %s was checkpointed from a different version of %s's experiment file\n", fname,
+                m->ec.id);
+        exit(0);
+    }
+    saved.verbose = m->verbose;
+    saved.warm = m->warm;
+    m->ec.d_sched = saved.ec.d_sched; /*the experiment as read afresh, at the schedules it had reached*/
+    m->ec.s_sched = saved.ec.s_sched;
+    m->ec.key = saved.ec.key;
+    saved.ec = m->ec;
+    saved.trade = trade_select(&(saved.ec)); /*a function's address needn't survive a restart*/
+    saved.day_fn = m->day_fn;
+    saved.day_arg = m->day_arg;
+    *m = saved;
+    if (*every == 0) *every = h.every; /*unless told otherwise, carry on as before*/
+    fprintf(stdout, "Resuming from %s at experiment %d\n", fname, h.e_next);
+    return (h.e_next);
+}
@@ -0,0 +1,30 @@
+//
+// checkpoint.h: save a run of experiments between experiments, and take it up again
+//
+// A checkpoint holds everything the rest of the run depends on: the market (the traders, the
+// schedule cursors and the stats carried from one experiment to the next), the generator's state
+// and the daily and per-trade stats so far. A run resumed from one gives exactly the output it would
+// have given had it never stopped. Checkpoints are written to a temporary file which is then renamed
+// over the last one, so a run killed while writing still leaves a whole checkpoint behind.
+
+#define CKPT_MAGIC "ZIPCKPT3"
+
+// Ckpt-head: what a checkpoint file starts with
+typedef struct a_ckpt_head {
+    char magic[8];               /*CKPT_MAGIC*/
+    int version;                 /*ENGINE_VERSION of the build that wrote it*/
+    int real_size;               /*and its sizeof(Real) and array bounds*/
+    int areal_size;              /*and sizeof(Areal)*/
+    int market_size;             /*and sizeof(Market)*/
+    int max_n_days, max_trades_b, max_agents, max_strat;
+    int n_exps;                  /*number of experiments in the run*/
+    int e_next;                  /*the first experiment still to run*/
+    int every;                   /*experiments between checkpoints*/
+    unsigned long long key;      /*cache_key() of the run's market: what its experiments depend on*/
+} Ckpt_head;
+
+void ckpt_name(char [], char []);
+
+void ckpt_save(char [], Market *, int n_exps, int e_next, int every, Day_data [], Real_stat []);
+
+int ckpt_load(char [], Market *, int n_exps, int *every, Day_data [], Real_stat []);
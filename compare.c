@@ -0,0 +1,214 @@
+//
+// compare.c: compare two configurations experiment by experiment (see compare.h)
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "ddat.h"
+#include "tdat.h"
+#include "expctl.h"
+#include "strategy.h"
+#include "book.h"
+#include "market.h"
+#include "shard.h"
+#include "compare.h"
+
+static char *cmp_names[CMP_N] = {"effic", "alpha", "pdisp", "quant", "price"};
+
+// Cmp-unit: one unit of comparison's sums for one day and statistic
+typedef struct a_cmp_unit {
+    Real a, b;                   /*sums of each configuration's values*/
+    int n;                       /*experiments in the sums*/
+} Cmp_unit;
+
+// cmp-values: the statistics of one day of an experiment; returns 0 if it made no deals. Such a day is still an
+// outcome: nothing was traded and no surplus made, and every trader missed its equilibrium profit; only its
+// alpha and price are undefined
+static int cmp_values(Exp_day *xd, Real v[]) {
+    v[CMP_EFFIC] = (xd->n_trades > 0 ? xd->effic : 0.0);
+    v[CMP_PDISP] = xd->pdisp;
+    v[CMP_QUANT] = xd->n_trades;
+    if (xd->n_trades == 0) {
+        v[CMP_ALPHA] = v[CMP_PRICE] = 0.0;
+        return (0);
+    }
+    v[CMP_ALPHA] = xd->alpha;
+    v[CMP_PRICE] = xd->sum_price / xd->n_trades;
+    return (1);
+}
+
+// cmp-defined: is stat s defined for a pair of days, given whether both made deals?
+static int cmp_defined(int s, int deals) {
+    return (deals || ((s != CMP_ALPHA) && (s != CMP_PRICE)));
+}
+
+// stat-add: add x to a sum and sum of squares
+static void stat_add(Real_stat *s, Real x) {
+    (s->sum) += x;
+    (s->sumsq) += (x * x);
+    (s->n)++;
+}
+
+// stat-var: the sample variance of a sum and sum of squares
+static Real stat_var(Real_stat *s) {
+    Real mean;
+
+    if (s->n < 2) return (0.0);
+    mean = s->sum / s->n;
+    return (((s->sumsq) - (s->n * mean * mean)) / (s->n - 1));
+}
+
+// t975: the 97.5% point of Student's t with df degrees of freedom (Cornish-Fisher, good to 0.5% at df=3)
+static Real t975(int df) {
+    Real z = 1.959964, z3 = z * z * z, z5 = z3 * z * z;
+
+    if (df < 1) return (0.0);
+    if (df == 1) return (12.706);
+    if (df == 2) return (4.303);
+    return (z + ((z3 + z) / (4.0 * df)) + (((5.0 * z5) + (16.0 * z3) + (3.0 * z)) / (96.0 * df * df)));
+}
+
+// compare-run: run experiments 0..n_exps-1 of markets a and b, and tabulate the paired differences of
+// their daily stats in the table fname
+void compare_run(Market *a, Market *b, int n_exps, char fname[]) {
+    int e, d, s, n_days, unit_end, deals;
+    Real va[CMP_N], vb[CMP_N], ma, mb, hw_paired, hw_unpaired, vd;
+    static Exp_result ra, rb;
+    static Cmp_unit u[MAX_N_DAYS][CMP_N];
+    static Real_stat sa[MAX_N_DAYS][CMP_N], sb[MAX_N_DAYS][CMP_N], sd[MAX_N_DAYS][CMP_N];
+    FILE *fp;
+
+    n_days = (a->ec.n_days < b->ec.n_days ? a->ec.n_days : b->ec.n_days);
+    if (a->ec.n_days != b->ec.n_days)
+        fprintf(stdout, "%s runs for %d days and %s for %d: comparing the first %d\n", a->ec.id, a->ec.n_days,
+                b->ec.id, b->ec.n_days, n_days);
+    if (a->anti && (n_exps & 1)) fprintf(stdout, "Odd number of experiments: the last has no antithetic twin\n");
+
+    for (e = 0; e < n_exps; e++) {
+        market_exp(a, e, n_exps, &ra);
+        market_exp(b, e, n_exps, &rb);
+        for (d = 0; d < n_days; d++) {
+            deals = cmp_values(ra.day + d, va);
+            deals &= cmp_values(rb.day + d, vb);
+            for (s = 0; s < CMP_N; s++) {
+                if (!cmp_defined(s, deals)) continue;
+                u[d][s].a += va[s];
+                u[d][s].b += vb[s];
+                (u[d][s].n)++;
+            }
+        }
+
+        /*a unit is one experiment, or an antithetic pair*/
+        unit_end = ((!a->anti) || (e & 1) || (e == n_exps - 1));
+        if (unit_end) {
+            for (d = 0; d < n_days; d++) {
+                for (s = 0; s < CMP_N; s++) {
+                    if (u[d][s].n > 0) {
+                        ma = u[d][s].a / u[d][s].n;
+                        mb = u[d][s].b / u[d][s].n;
+                        stat_add(&(sa[d][s]), ma);
+                        stat_add(&(sb[d][s]), mb);
+                        stat_add(&(sd[d][s]), mb - ma);
+                    }
+                    u[d][s].a = u[d][s].b = 0.0;
+                    u[d][s].n = 0;
+                }
+            }
+        }
+        fprintf(stdout, "experiment %d done\n", e);
+    }
+
+    fp = fopen(fname, "w");
+    fprintf(fp, "# A=%s B=%s: %d experiments, %s random numbers%s\n", a->ec.id, b->ec.id, n_exps,
+            (a->crn ? "common" : "independent"), (a->anti ? ", antithetic pairs" : ""));
+    fprintf(fp, "# day stat n mean_A mean_B diff(B-A) ci95_paired ci95_unpaired var_reduction\n");
+    for (d = 0; d < n_days; d++) {
+        for (s = 0; s < CMP_N; s++) {
+            if (sd[d][s].n == 0) continue;
+            hw_paired = t975(sd[d][s].n - 1) * sqrt(stat_var(&(sd[d][s])) / sd[d][s].n);
+            hw_unpaired = t975(sd[d][s].n - 1) *
+                          sqrt((stat_var(&(sa[d][s])) + stat_var(&(sb[d][s]))) / sd[d][s].n);
+            vd = stat_var(&(sd[d][s]));
+            fprintf(fp, "%d %s %d %f %f %f %f %f ", d + 1, cmp_names[s], sd[d][s].n, sa[d][s].sum / sa[d][s].n,
+                    sb[d][s].sum / sb[d][s].n, sd[d][s].sum / sd[d][s].n, hw_paired, hw_unpaired);
+            if (vd > 0.0) fprintf(fp, "%f\n", (stat_var(&(sa[d][s])) + stat_var(&(sb[d][s]))) / vd);
+            else fprintf(fp, "-\n");
+            if (d == n_days - 1)
+                fprintf(stdout, "day %d %s: B-A = %f +/- %f (unpaired +/- %f)\n", d + 1, cmp_names[s],
+                        sd[d][s].sum / sd[d][s].n, hw_paired, hw_unpaired);
+        }
+    }
+    fclose(fp);
+}
+
+// compare-drift: tabulate the paired differences, experiment by experiment, between the daily stats in
+// shard files fa and fb, which hold the same experiments of the same run, in <id>drift.dat
+void compare_drift(char fa[], char fb[]) {
+    int e, d, s, deals;
+    Real va[CMP_N], vb[CMP_N], diff, hw_paired;
+    Shard_head ha, hb;
+    char fname[MAX_ID + 20];
+    static Exp_result ra, rb;
+    static Real_stat sa[MAX_N_DAYS][CMP_N], sb[MAX_N_DAYS][CMP_N], sd[MAX_N_DAYS][CMP_N];
+    static Real max_d[MAX_N_DAYS][CMP_N];
+    FILE *fpa, *fpb, *fp;
+
+    fpa = shard_open(fa, &ha);
+    fpb = shard_open(fb, &hb);
+    if ((strcmp(ha.id, hb.id) != 0) || (ha.n_exps != hb.n_exps) || (ha.rs != hb.rs) || (ha.n_days != hb.n_days) ||
+        (ha.first != hb.first) || (ha.last != hb.last)) {
+        fprintf(stderr, "\nFail: %s and %s don't hold the same experiments of the same run\n", fa, fb);
+        exit(0);
+    }
+    if (ha.key != hb.key) {
+        fprintf(stderr, "\nFail: %s and %s are shards of runs of %s with different experiment files or parameters\n",
+                fa, fb, ha.id);
+        exit(0);
+    }
+    if (ha.areal_size == hb.areal_size)
+        fprintf(stdout, "%s and %s come from builds of the same precision: expect no drift\n", fa, fb);
+
+    for (e = ha.first; e <= ha.last; e++) {
+        shard_next(fpa, fa, e, &ra);
+        shard_next(fpb, fb, e, &rb);
+        for (d = 0; d < ha.n_days; d++) {
+            deals = cmp_values(ra.day + d, va);
+            deals &= cmp_values(rb.day + d, vb);
+            for (s = 0; s < CMP_N; s++) {
+                if (!cmp_defined(s, deals)) continue;
+                stat_add(&(sa[d][s]), va[s]);
+                stat_add(&(sb[d][s]), vb[s]);
+                stat_add(&(sd[d][s]), vb[s] - va[s]);
+                diff = fabs(vb[s] - va[s]);
+                if (diff > max_d[d][s]) max_d[d][s] = diff;
+            }
+        }
+    }
+    fclose(fpa);
+    fclose(fpb);
+
+    sprintf(fname, "%sdrift.dat", ha.id);
+    fp = fopen(fname, "w");
+    fprintf(fp, "# A=%s (%d-byte traders) B=%s (%d-byte traders): experiments %d..%d of %s\n", fa, ha.areal_size,
+            fb, hb.areal_size, ha.first, ha.last, ha.id);
+    fprintf(fp, "# day stat n mean_A mean_B diff(B-A) ci95_paired max_abs_diff\n");
+    for (d = 0; d < ha.n_days; d++) {
+        for (s = 0; s < CMP_N; s++) {
+            if (sd[d][s].n == 0) continue;
+            hw_paired = t975(sd[d][s].n - 1) * sqrt(stat_var(&(sd[d][s])) / sd[d][s].n);
+            fprintf(fp, "%d %s %d %f %f %f %f %f\n", d + 1, cmp_names[s], sd[d][s].n, sa[d][s].sum / sa[d][s].n,
+                    sb[d][s].sum / sb[d][s].n, sd[d][s].sum / sd[d][s].n, hw_paired, max_d[d][s]);
+            if (d == ha.n_days - 1)
+                fprintf(stdout, "day %d %s: B-A = %f +/- %f, at most %f in one experiment\n", d + 1, cmp_names[s],
+                        sd[d][s].sum / sd[d][s].n, hw_paired, max_d[d][s]);
+        }
+    }
+    fclose(fp);
+    fprintf(stdout, "Writing %s\n", fname);
+}
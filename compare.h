@@ -0,0 +1,24 @@
+//
+// compare.h: compare two configurations experiment by experiment
+//
+// Experiment e of one configuration is paired with experiment e of the other, and each day's
+// statistics are compared through their paired differences. Under common random numbers (smith -N)
+// both draw the same initial margins, shouters, counterparties and target prices, so the
+// differences are not buried in noise from the seed, and a confidence interval on a difference
+// needs far fewer experiments than it would with independent streams. With antithetic pairs
+// (smith -A) the average of experiments 2k and 2k+1 is the unit of comparison.
+//
+// The same pairing measures the drift of single-precision traders (smith32) from double ones: two shards
+// of the same experiments, one from each build, are run on the same seeds, so every difference between
+// them is rounding.
+
+#define CMP_EFFIC 0  /*the statistics compared*/
+#define CMP_ALPHA 1
+#define CMP_PDISP 2
+#define CMP_QUANT 3
+#define CMP_PRICE 4
+#define CMP_N     5
+
+void compare_run(Market *, Market *, int, char []);
+
+void compare_drift(char [], char []);
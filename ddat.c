@@ -9,8 +9,10 @@
 #include <string.h>
 
 #include "random.h"
-#include "ddat.h"
 #include "max.h"
+#include "agent.h"
+#include "strategy.h"
+#include "ddat.h"
 
 #define SMALLREAL 0.0000001 /*used to dodge rounding errors on sqrt */
 #define DD_ALPHA  0
@@ -27,14 +29,81 @@ void rstat_zero(Real_stat *r) {
     r->n = 0;
 }
 
+// rstat-add: add one observation to a Real-stat structure
+void rstat_add(Real_stat *r, Real x) {
+    (r->sum) += x;
+    (r->sumsq) += (x * x);
+    (r->n)++;
+}
+
+// rstat-msd: write the mean and standard deviation of a Real-stat, after a space each
+void rstat_msd(FILE *fp, Real_stat *r) {
+    Real mean = 0.0, var = 0.0;
+
+    if (r->n > 0) {
+        mean = r->sum / r->n;
+        var = (r->sumsq / r->n) - (mean * mean);
+        if (var < 0.0) var = 0.0;
+    }
+    fprintf(fp, " %f %f", mean, sqrt(var));
+}
+
 // ddat-init: initialise day data
 void ddat_init(Day_data *ddat) {
+    int st;
+
     rstat_zero(&(ddat->alpha));
     rstat_zero(&(ddat->quant));
     rstat_zero(&(ddat->effic));
     rstat_zero(&(ddat->price));
     rstat_zero(&(ddat->pdisp));
     rstat_zero(&(ddat->volty));
+    for (st = 0; st < MAX_STRAT; st++) {
+        rstat_zero(ddat->s_effic + st);
+        rstat_zero(ddat->s_profit + st);
+    }
+}
+
+// ddat-strat-sums: count the agents of each strategy and sum their actual and theoretical gains
+void ddat_strat_sums(Agent sellers[], int n_sell, Agent buyers[], int n_buy,
+                     int n[], Real a_gain[], Real t_gain[]) {
+    int a, st;
+
+    for (st = 0; st < MAX_STRAT; st++) {
+        n[st] = 0;
+        a_gain[st] = 0.0;
+        t_gain[st] = 0.0;
+    }
+    for (a = 0; a < n_sell; a++) {
+        n[sellers[a].strat]++;
+        a_gain[sellers[a].strat] += sellers[a].a_gain;
+        t_gain[sellers[a].strat] += sellers[a].t_gain;
+    }
+    for (a = 0; a < n_buy; a++) {
+        n[buyers[a].strat]++;
+        a_gain[buyers[a].strat] += buyers[a].a_gain;
+        t_gain[buyers[a].strat] += buyers[a].t_gain;
+    }
+}
+
+// ddat-strat-add: update the per-strategy daily data from each strategy's agent count and gains
+void ddat_strat_add(Day_data *dd, int n[], Real a_gain[], Real t_gain[]) {
+    int st;
+
+    for (st = 0; st < MAX_STRAT; st++) {
+        if (n[st] == 0) continue;
+        rstat_add(dd->s_profit + st, a_gain[st] / n[st]);
+        if (t_gain[st] > 0.0) rstat_add(dd->s_effic + st, (a_gain[st] / t_gain[st]) * 100);
+    }
+}
+
+// ddat-strat-update: update the per-strategy efficiency (actual over theoretical gain) and profit per agent
+void ddat_strat_update(Day_data *dd, Agent sellers[], int n_sell, Agent buyers[], int n_buy) {
+    int n[MAX_STRAT];
+    Real a_gain[MAX_STRAT], t_gain[MAX_STRAT];
+
+    ddat_strat_sums(sellers, n_sell, buyers, n_buy, n, a_gain, t_gain);
+    ddat_strat_add(dd, n, a_gain, t_gain);
 }
 
 // ddat-update: update day data.
@@ -164,6 +233,54 @@ void ddat_meanpmsd(FILE *fp, int field, int n_days, int n_exps, Day_data dd[]) {
     fprintf(fp, "\n");
 }
 
+// rstat-meanpmsd: plot mean plus and minus one standard deviation of one Real-stat per day, skipping empty days
+void rstat_meanpmsd(FILE *fp, char *label, int n_days, Real_stat rs[]) {
+    int d, k;
+    Real mean, diff;
+    Real_stat *r;
+    static char *suffix[3] = {"mean", "-1s.d.", "+1s.d."};
+
+    for (k = 0; k < 3; k++) {
+        fprintf(fp, "\" %s (%s)\n", label, suffix[k]);
+        for (d = 0; d < n_days; d++) {
+            r = rs + d;
+            if (r->n == 0) continue;
+            mean = r->sum / r->n;
+            diff = (r->sumsq / r->n) - (mean * mean);
+            if (diff < SMALLREAL) diff = 0.0;
+            if (k == 1) mean -= sqrt(diff);
+            if (k == 2) mean += sqrt(diff);
+            fprintf(fp, "%d %f\n", d + 1, mean);
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+// xg-strat-graph: plot the per-strategy daily stats in xgraph format
+void xg_strat_graph(Day_data dd[], int n_days, int n_exps, int strat_mask, char *fname) {
+    int d, st;
+    Real_stat effic[MAX_N_DAYS], profit[MAX_N_DAYS];
+    char label[40];
+    FILE *fp;
+
+    fp = fopen(fname, "w");
+
+    fprintf(fp, "TitleText: %s: n=%d\n\n", fname, n_exps);
+
+    for (st = 0; st < MAX_STRAT; st++) {
+        if (!(strat_mask & (1 << st))) continue;
+        for (d = 0; d < n_days; d++) {
+            effic[d] = dd[d].s_effic[st];
+            profit[d] = dd[d].s_profit[st];
+        }
+        sprintf(label, "%s Efficiency", strategies[st].name);
+        rstat_meanpmsd(fp, label, n_days, effic);
+        sprintf(label, "%s Profit", strategies[st].name);
+        rstat_meanpmsd(fp, label, n_days, profit);
+    }
+    fclose(fp);
+}
+
 // ddat-xgraph: plot the daily stats in xgraph format
 void xg_daily_graph(Day_data dd[], int n_days, int n_exps, char *fname) {
     int d;
@@ -20,13 +20,30 @@ typedef struct day_data {
     Real_stat price; /*price*/
     Real_stat pdisp; /*profit dispersal*/
     Real_stat volty; /*transaction price    volatility*/
+    Real_stat s_effic[MAX_STRAT];  /*efficiency of each strategy's agents*/
+    Real_stat s_profit[MAX_STRAT]; /*profit per agent of each strategy*/
 } Day_data;
 
+// rstat-msd: write the mean and standard deviation of a Real-stat
+void rstat_msd(FILE *, Real_stat *);
+
 // ddat-init: initialise daily data
 void ddat_init(Day_data *);
 
 // ddat-update: update daily data
 void ddat_update(Day_data *, int, Real, Real, Real, Real, Real);
 
+// ddat-strat-sums: count the agents of each strategy and sum their actual and theoretical gains
+void ddat_strat_sums(Agent [], int, Agent [], int, int [], Real [], Real []);
+
+// ddat-strat-add: update the per-strategy daily data from each strategy's agent count and gains
+void ddat_strat_add(Day_data *, int [], Real [], Real []);
+
+// ddat-strat-update: update the per-strategy daily data from the sellers' and buyers' gains
+void ddat_strat_update(Day_data *, Agent [], int, Agent [], int);
+
 // ddat-xgraph: plot the daily stats in xgraph format
 void xg_daily_graph(Day_data dd[], int, int, char *);
+
+// xg-strat-graph: plot the per-strategy daily stats of the strategies in a mask, in xgraph format
+void xg_strat_graph(Day_data dd[], int, int, int, char *);
@@ -6,377 +6,646 @@
 // This does some validity checks but still need to be careful that the data-file it reads from is structured correctly.
 // When there is more than one schedule for supply or demand, they must be listed in the data-file in the order they 
 // are to become active. The first-day for the 0th schedule is set to zero, whatever value is given in the data-file
+//
+// An agent's line may end with the name of its strategy (zip, zic or ziu); agents without one use the strategy given
+// by the random flag. Within each schedule the agents are regrouped so that each strategy's agents are contiguous.
+//
+// The file is mapped into memory and read in one pass by a small tokenizer: values are separated by white space,
+// and a `#' where a value could start comments out the rest of its line. Numbers are read straight into Real, and
+// everything the file says is checked, so that the first thing wrong with it is reported as file:line:column.
+//
+// A file beginning with IMAGE_MAGIC is an experiment already compiled by "smith compile" (see image.h): it is
+// left mapped, and the Expctl's schedules point into it.
 
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "random.h"
 #include "max.h"
+#include "agent.h"
+#include "strategy.h"
 #include "expctl.h"
+#include "image.h"
+#include "book.h"
+
+#define TK_LEN 64 /*longest number or name*/
+
+// Tok: a cursor over an experiment file mapped into memory
+typedef struct a_tok {
+    char *fname;
+    const char *p, *end;         /*the next character, and the end of the file*/
+    const char *line_start;      /*the start of the line p is on*/
+    int line;
+    int tok_line, tok_col;       /*where the last value read started, for reporting errors*/
+    int a, u;                    /*the agent and unit being read, for naming what is wrong*/
+    int n_dem, n_sup;            /*the schedules read so far, which a generator may shift*/
+    int place[2][MAX_SCHED][MAX_AGENTS]; /*the file's agent at each place of each demand (0) and supply (1)
+                                            schedule, once its agents are regrouped by strategy*/
+    char *err;                   /*where to describe the first error*/
+    int errlen;
+} Tok;
+
+// tk-fail: describe an error at the last value read; returns its code
+static int tk_fail(Tok *t, int code, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    n = snprintf(t->err, t->errlen, "%s:%d:%d: ", t->fname, t->tok_line, t->tok_col);
+    if ((n >= 0) && (n < t->errlen)) {
+        va_start(ap, fmt);
+        vsnprintf(t->err + n, t->errlen - n, fmt, ap);
+        va_end(ap);
+    }
+    return (code);
+}
 
-#define LLEN 1024 /*max. no. of characters in a line*/
+// tk-mark: note that a value starts here
+static void tk_mark(Tok *t) {
+    t->tok_line = t->line;
+    t->tok_col = (int) (t->p - t->line_start) + 1;
+}
 
-// get-non-comment-line: read to start of next line that doesn't start with `#'
-int get_non_comment_line(FILE *fp) {
-    int c, reading = 1;
-    char s[LLEN];
+// tk-skip: skip white space and comments
+static void tk_skip(Tok *t) {
+    while (t->p < t->end) {
+        if (*(t->p) == '\n') {
+            (t->p)++;
+            (t->line)++;
+            t->line_start = t->p;
+        } else if (isspace((unsigned char) *(t->p))) (t->p)++;
+        else if (*(t->p) == '#') { while ((t->p < t->end) && (*(t->p) != '\n')) (t->p)++; }
+        else return;
+    }
+}
 
-    while (reading) { /*get to first non-whitespace char*/
-        c = ' ';
-        while (isspace(c)) {
-            c = fgetc(fp);
-            if (c == EOF) return (EOF);
-        }
+// tk-what: name the value being read; what may refer to the agent and unit being read, as printf formats
+static char *tk_what(Tok *t, const char *what, char buf[], int size) {
+    snprintf(buf, size, what, t->a, t->u);
+    return (buf);
+}
 
-        /*is this a comment line?*/
-        if (c == '#') { /*yes: read the rest of this line*/
-            ungetc(c, fp);
-            fgets(s, LLEN, fp);
-        } else { /*no: put the char back and exit*/
-            ungetc(c, fp);
-            return (EOF - 1); /*i.e. something that     isn't EOF*/
-        }
+// tk-word: read the next value, up to white space or a comment, into buf
+static int tk_word(Tok *t, char buf[], int size, const char *what) {
+    int n = 0;
+    char w[TK_LEN];
+
+    tk_skip(t);
+    tk_mark(t);
+    if (t->p == t->end) return (tk_fail(t, EC_EOF, "the file ends before %s", tk_what(t, what, w, TK_LEN)));
+    while ((t->p < t->end) && (!isspace((unsigned char) *(t->p))) && (*(t->p) != '#')) {
+        if (n == size - 1) return (tk_fail(t, EC_SYNTAX, "%s is longer than %d characters", tk_what(t, what, w, TK_LEN), size - 1));
+        buf[n++] = *((t->p)++);
     }
+    buf[n] = '\0';
+    return (EC_OK);
 }
 
-// read-sched: read a supply or demand schedule
-int read_sched(FILE *fp, SD_sched *sched, int verbose) {
-    int i, *pi, a, u;
-    float f, *pf;
-
-    pi = &i;
-    pf = &f;
-
-    /*read number of agents*/
-    if (get_non_comment_line(fp) != EOF) {
-        if (fscanf(fp, "%d", pi) != EOF) {
-            sched->n_agents = (*pi);
-            if ((sched->n_agents < 1) || (sched->n_agents > MAX_AGENTS)) {
-                fprintf(stderr, "\nFail: # agents must be in range {1,...,%d}\n",
-                        MAX_AGENTS);
-                exit(0);
-            }
-            if (verbose) {
-                fprintf(stdout, " %d agents: ", sched->n_agents);
-                fflush(stdout);
-            }
-        } else {
-            fprintf(stderr, "\nFail: can't read # agents \n");
-            exit(0);
-        }
-    } else {
-        fprintf(stderr, "\nFail: EOF reading # agents\n");
-        exit(0);
+// tk-int: read an integer in the range {lo,...,hi}
+static int tk_int(Tok *t, int *v, int lo, int hi, const char *what) {
+    char buf[TK_LEN], w[TK_LEN], *q;
+    long l;
+    int code;
+
+    if ((code = tk_word(t, buf, TK_LEN, what)) != EC_OK) return (code);
+    errno = 0;
+    l = strtol(buf, &q, 10);
+    if ((*q != '\0') || (q == buf) || (errno != 0))
+        return (tk_fail(t, EC_SYNTAX, "expected an integer for %s, found \"%s\"", tk_what(t, what, w, TK_LEN), buf));
+    if ((l < lo) || (l > hi))
+        return (tk_fail(t, EC_RANGE, "%s must be in range {%d,...,%d}, not %ld", tk_what(t, what, w, TK_LEN), lo, hi, l));
+    *v = (int) l;
+    return (EC_OK);
+}
+
+// tk-num: read a finite number, straight into a Real
+static int tk_num(Tok *t, Real *v, const char *what) {
+    char buf[TK_LEN], w[TK_LEN], *q;
+    int code;
+
+    if ((code = tk_word(t, buf, TK_LEN, what)) != EC_OK) return (code);
+    *v = strtod(buf, &q);
+    if ((*q != '\0') || (q == buf) || (!isfinite(*v)))
+        return (tk_fail(t, EC_SYNTAX, "expected a number for %s, found \"%s\"", tk_what(t, what, w, TK_LEN), buf));
+    return (EC_OK);
+}
+
+// tk-real: read a non-negative finite number, straight into a Real
+static int tk_real(Tok *t, Real *v, const char *what) {
+    char w[TK_LEN];
+    int code;
+
+    if ((code = tk_num(t, v, what)) != EC_OK) return (code);
+    if (*v < 0.0) return (tk_fail(t, EC_RANGE, "%s is negative (%g)", tk_what(t, what, w, TK_LEN), *v));
+    return (EC_OK);
+}
+
+// tk-price: read a limit price, or a generator's: a non-negative number no higher than PRICE_MAX
+static int tk_price(Tok *t, Real *v, const char *what) {
+    char w[TK_LEN];
+    int code;
+
+    if ((code = tk_real(t, v, what)) != EC_OK) return (code);
+    if (*v > PRICE_MAX)
+        return (tk_fail(t, EC_RANGE, "%s is above PRICE_MAX=%g (%g)", tk_what(t, what, w, TK_LEN), PRICE_MAX, *v));
+    return (EC_OK);
+}
+
+// tk-eol: skip blanks up to the end of the line; is there nothing else on it, bar a comment?
+static int tk_eol(Tok *t) {
+    while ((t->p < t->end) && ((*(t->p) == ' ') || (*(t->p) == '\t') || (*(t->p) == '\r'))) (t->p)++;
+    return ((t->p == t->end) || (*(t->p) == '\n') || (*(t->p) == '#'));
+}
+
+// tk-strategy: read the optional strategy name that may end an agent's or generator's line, then check the line
+// ends
+static int tk_strategy(Tok *t, int *strategy) {
+    char buf[TK_LEN];
+    int code, st;
+
+    if ((!tk_eol(t)) && isalpha((unsigned char) *(t->p))) {
+        if ((code = tk_word(t, buf, TK_LEN, "a strategy name")) != EC_OK) return (code);
+        if ((st = strategy_lookup(buf)) < 0) return (tk_fail(t, EC_STRATEGY, "unknown strategy \"%s\"", buf));
+        *strategy = st;
+    }
+    if (!tk_eol(t)) {
+        tk_mark(t);
+        return (tk_fail(t, EC_SYNTAX, "unexpected text at the end of the line"));
     }
+    return (EC_OK);
+}
 
-    /*read start day*/
-    if (get_non_comment_line(fp) != EOF) {
-        if (fscanf(fp, "%d", pi) != EOF) {
-            sched->first_day = (*pi);
-            if (verbose) {
-                fprintf(stdout, "from day %d ", sched->first_day);
-                fflush(stdout);
-            }
+// partition-sched: stably regroup a schedule's agents so each strategy's agents are contiguous; returns EC_OK,
+// or EC_NOMEM
+int partition_sched(SD_sched *sched) {
+    int a, st, n;
+    static _Thread_local Agent_sched *tmp = NULL; /*each thread's own, on the heap: too big for the stack*/
+
+    if ((tmp == NULL) && ((tmp = malloc(MAX_AGENTS * sizeof(Agent_sched))) == NULL)) return (EC_NOMEM);
+    n = 0;
+    sched->n_part = 0;
+    for (st = 0; st < MAX_STRAT; st++) {
+        sched->part[sched->n_part].strategy = st;
+        sched->part[sched->n_part].first = n;
+        for (a = 0; a < sched->n_agents; a++) {
+            if (sched->agents[a].strategy == st) tmp[n++] = sched->agents[a];
         }
+        sched->part[sched->n_part].n = n - sched->part[sched->n_part].first;
+        if (sched->part[sched->n_part].n > 0) (sched->n_part)++;
     }
+    for (a = 0; a < sched->n_agents; a++) sched->agents[a] = tmp[a];
+    return (EC_OK);
+}
 
-    /*read end day*/
-    if (get_non_comment_line(fp) != EOF) {
-        if (fscanf(fp, "%d", pi) != EOF) {
-            sched->last_day = (*pi);
-            if (sched->last_day < sched->first_day) {
-                fprintf(stderr, "\nFail: last_day(%d)<first_day(%d)\n",
-                        sched->last_day, sched->first_day);
-                exit(0);
-            }
-            if (verbose) {
-                fprintf(stdout, "to day %d\n", sched->last_day);
-                fflush(stdout);
-            }
+// gen-uniform: the next number in [0,1) of a generator's own stream (splitmix64), so that a schedule drawn at
+// random is the same whatever the run's seed
+static Real gen_uniform(unsigned long long *x) {
+    unsigned long long z;
+
+    z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return ((z >> 11) * (1.0 / 9007199254740992.0));
+}
+
+// read-gen: read a generator, which gives every agent of a schedule its limit prices in one line:
+//   linear first last          from first to last in equal steps
+//   step first last n_steps    likewise, in n_steps equal groups of agents
+//   uniform lo hi seed         drawn uniformly from [lo,hi] by a stream of the generator's own
+//   shift dem|sup s delta      those of an earlier demand or supply schedule s, plus delta
+// optionally followed by "units n" (n units per agent, all at its limit price; not for shift) and a strategy name.
+// A shifted schedule's agents keep the places they have in the schedule shifted.
+static int read_gen(Tok *t, Expctl *ec, SD_sched *sched, int place[], int strategy) {
+    char kind[TK_LEN], buf[TK_LEN];
+    int a, u, n, k, code, units = 1, n_steps = 1, seed = 0;
+    Real first, last, delta = 0.0, l;
+    Cents c;
+    unsigned long long x;
+    SD_sched *from = NULL;
+    int *from_place = NULL;
+
+    n = sched->n_agents;
+    if ((code = tk_word(t, kind, TK_LEN, "a generator")) != EC_OK) return (code);
+    if ((strcmp(kind, "linear") == 0) || (strcmp(kind, "step") == 0) || (strcmp(kind, "uniform") == 0)) {
+        if ((code = tk_price(t, &first, "the generator's first price")) != EC_OK) return (code);
+        if ((code = tk_price(t, &last, "the generator's last price")) != EC_OK) return (code);
+        if (strcmp(kind, "step") == 0) {
+            if ((code = tk_int(t, &n_steps, 1, n, "# steps")) != EC_OK) return (code);
+        }
+        if (strcmp(kind, "uniform") == 0) {
+            if (last < first) return (tk_fail(t, EC_RANGE, "uniform's hi price is below its lo price"));
+            if ((code = tk_int(t, &seed, 0, 0x7fffffff, "the generator's seed")) != EC_OK) return (code);
         }
+    } else if (strcmp(kind, "shift") == 0) {
+        if ((code = tk_word(t, buf, TK_LEN, "dem or sup")) != EC_OK) return (code);
+        if (strcmp(buf, "dem") == 0) {
+            if (t->n_dem == 0) return (tk_fail(t, EC_RANGE, "no demand schedule has been read yet to shift"));
+            if ((code = tk_int(t, &k, 0, t->n_dem - 1, "the demand schedule shifted")) != EC_OK) return (code);
+            from = ec->dem_sched + k;
+            from_place = t->place[0][k];
+        } else if (strcmp(buf, "sup") == 0) {
+            if (t->n_sup == 0) return (tk_fail(t, EC_RANGE, "no supply schedule has been read yet to shift"));
+            if ((code = tk_int(t, &k, 0, t->n_sup - 1, "the supply schedule shifted")) != EC_OK) return (code);
+            from = ec->sup_sched + k;
+            from_place = t->place[1][k];
+        } else return (tk_fail(t, EC_SYNTAX, "expected dem or sup, found \"%s\"", buf));
+        if (from->n_agents != n)
+            return (tk_fail(t, EC_RANGE, "shifting a schedule of %d agents into one of %d", from->n_agents, n));
+        if ((code = tk_num(t, &delta, "the shift")) != EC_OK) return (code);
+        if (fabs(delta) > PRICE_MAX) return (tk_fail(t, EC_RANGE, "the shift is beyond +/-PRICE_MAX=%g (%g)",
+                                                     PRICE_MAX, delta));
+    } else return (tk_fail(t, EC_SYNTAX, "unknown generator \"%s\"", kind));
+
+    /*then perhaps units, then perhaps a strategy, and nothing else*/
+    if ((!tk_eol(t)) && (t->end - t->p >= 5) && (strncmp(t->p, "units", 5) == 0)) {
+        if ((code = tk_word(t, buf, TK_LEN, "units")) != EC_OK) return (code);
+        if (from != NULL) return (tk_fail(t, EC_SYNTAX, "shift copies its schedule's units: no units allowed"));
+        if ((code = tk_int(t, &units, 1, MAX_UNITS, "units per agent")) != EC_OK) return (code);
     }
-
-    /*read shout ag*/
-    if (get_non_comment_line(fp) != EOF) {
-        if (fscanf(fp, "%d", pi) != EOF) {
-            sched->can_shout = (*pi);
-            if ((sched->can_shout < 0) || (sched->can_shout > 1)) {
-                fprintf(stderr, "\nFail: can_shout not Boolean (%d)\n",
-                        sched->can_shout);
-                exit(0);
-            }
-            if (verbose) {
-                if (sched->can_shout) {
-                    fprintf(stdout, "(These traders CAN SHOUT)\n");
-                    fflush(stdout);
+    if ((code = tk_strategy(t, &strategy)) != EC_OK) return (code);
+
+    x = (unsigned long long) seed;
+    for (a = 0; a < n; a++) {
+        if (from != NULL) {
+            sched->agents[a].n_units = from->agents[a].n_units;
+            for (u = 0; u < from->agents[a].n_units; u++) {
+                c = from->agents[a].limit[u] + CENTS(delta);
+                if (c < 0) {
+                    t->a = a;
+                    return (tk_fail(t, EC_RANGE, "the shift makes agent %d's limit price %d negative", a, u + 1));
                 }
-                else {
-                    fprintf(stdout, "(These traders are SILENT)\n");
-                    fflush(stdout);
+                if (c > CENTS(PRICE_MAX)) {
+                    t->a = a;
+                    return (tk_fail(t, EC_RANGE, "the shift makes agent %d's limit price %d above PRICE_MAX=%g", a,
+                                    u + 1, PRICE_MAX));
                 }
+                sched->agents[a].limit[u] = c;
             }
+        } else {
+            if (strcmp(kind, "uniform") == 0) l = first + (last - first) * gen_uniform(&x);
+            else if (strcmp(kind, "step") == 0)
+                l = (n_steps == 1 ? first : first + ((last - first) * (((long) a * n_steps) / n)) / (n_steps - 1));
+            else l = (n == 1 ? first : first + ((last - first) * a) / (n - 1));
+            sched->agents[a].n_units = units;
+            for (u = 0; u < units; u++) sched->agents[a].limit[u] = CENTS(l);
         }
+        sched->agents[a].strategy = strategy;
+        place[a] = (from != NULL ? from_place[a] : a);
     }
+    return (EC_OK);
+}
 
-    /*read agent pricing specs*/
-    for (a = 0; a < sched->n_agents; a++) {
-        if (get_non_comment_line(fp) != EOF) {
-            if (fscanf(fp, "%d", pi) != EOF) {
-                sched->agents[a].n_units = (*pi);
-                if ((sched->agents[a].n_units < 1) || (sched->agents[a].n_units > MAX_UNITS)) {
-                    fprintf(stderr, "\nFail: # units must be inrange {1,...,%d}\n",
-                            MAX_UNITS);
-                    exit(0);
-                }
+// read-sched: read demand (side 0) or supply (side 1) schedule k, agent by agent or from a generator; agents not
+// tagged with a strategy get the default one. A trader's state carries over from one schedule to the next by
+// its place, so every schedule of a side must regroup its agents by strategy into the places of the first.
+static int read_sched(Tok *t, Expctl *ec, int side, int k, int strategy, int verbose) {
+    int a, u, p, n, st, code, gen, *place = t->place[side][k];
+    Real l;
+    SD_sched *sched = (side == 0 ? ec->dem_sched : ec->sup_sched) + k;
 
-                if (verbose) {
-                    fprintf(stdout, "     Agent %2d, %d units: ", a, sched->agents[a].n_units);
-                    fflush(stdout);
-                }
+    if ((code = tk_int(t, &(sched->n_agents), 1, MAX_AGENTS, "# agents")) != EC_OK) return (code);
+    if (verbose) fprintf(stdout, " %d agents: ", sched->n_agents);
 
-                for (u = 0; u < sched->agents[a].n_units; u++) {
-                    if (fscanf(fp, "%f", pf) != EOF) {
-                        sched->agents[a].limit[u] = (Real) (*pf);
-                        if (sched->agents[a].limit[u] < 0.0) {
-                            fprintf(stderr, "\nFail: negative price (%f)\n", *pf);
-                            exit(0);
-                        }
-                        if (verbose) {
-                            fprintf(stdout, "%f ", sched->agents[a].limit[u]);
-                            fflush(stdout);
-                        }
-                    }
-                }
+    if ((code = tk_int(t, &(sched->first_day), 0, MAX_N_DAYS, "start day")) != EC_OK) return (code);
+    if (verbose) fprintf(stdout, "from day %d ", sched->first_day);
 
-                if (verbose) {
-                    fprintf(stdout, "\n");
-                    fflush(stdout);
-                }
+    if ((code = tk_int(t, &(sched->last_day), sched->first_day, MAX_N_DAYS, "end day")) != EC_OK) return (code);
+    if (verbose) fprintf(stdout, "to day %d\n", sched->last_day);
+
+    if ((code = tk_int(t, &(sched->can_shout), 0, 1, "can_shout")) != EC_OK) return (code);
+    if (verbose) {
+        if (sched->can_shout) fprintf(stdout, "(These traders CAN SHOUT)\n");
+        else fprintf(stdout, "(These traders are SILENT)\n");
+    }
+
+    /*a generator, or for each agent: number of units, the limit price of each, and maybe a strategy*/
+    tk_skip(t);
+    gen = ((t->p < t->end) && isalpha((unsigned char) *(t->p)));
+    if (gen && ((code = read_gen(t, ec, sched, place, strategy)) != EC_OK)) return (code);
+    for (a = 0; a < sched->n_agents; a++) {
+        if (!gen) {
+            t->a = a;
+            if ((code = tk_int(t, &(sched->agents[a].n_units), 1, MAX_UNITS, "agent %d's # units")) != EC_OK)
+                return (code);
+            for (u = 0; u < sched->agents[a].n_units; u++) {
+                t->u = u + 1;
+                if ((code = tk_price(t, &l, "agent %d's limit price %d")) != EC_OK) return (code);
+                sched->agents[a].limit[u] = CENTS(l);
             }
+            sched->agents[a].strategy = strategy;
+            if ((code = tk_strategy(t, &(sched->agents[a].strategy))) != EC_OK) return (code);
+        }
+        if (verbose) {
+            fprintf(stdout, "     Agent %2d, %d units: ", a, sched->agents[a].n_units);
+            for (u = 0; u < sched->agents[a].n_units; u++) fprintf(stdout, "%f ", PRICE(sched->agents[a].limit[u]));
+            if (sched->agents[a].strategy != strategy)
+                fprintf(stdout, "(%s)", strategies[sched->agents[a].strategy].name);
+            fprintf(stdout, "\n");
         }
     } /*end of reading the agent data*/
-}
-
-// expctl-in: read expctl data from a specified file
-void expctl_in(char filename[], Expctl *ec, int verbose) {
-    int *pi, i, sched;
-    float f, *pf;
-    FILE *fp;
 
-    fp = fopen(filename, "r");
-    if (fp == NULL) {
-        fprintf(stderr, "\nFAIL: can't open \"%s\" as expctl input file\n", filename);
-        exit(0);
+    if (!gen) { /*where partition_sched() will put each agent; a generator's agents are in place already*/
+        p = 0;
+        for (st = 0; st < MAX_STRAT; st++) {
+            for (a = 0; a < sched->n_agents; a++) { if (sched->agents[a].strategy == st) place[p++] = a; }
+        }
+    }
+    if (partition_sched(sched) != EC_OK) return (tk_fail(t, EC_NOMEM, "out of memory regrouping the agents"));
+
+    n = (side == 0 ? ec->dem_sched : ec->sup_sched)[0].n_agents;
+    if (n > sched->n_agents) n = sched->n_agents;
+    for (p = 0; (k > 0) && (p < n); p++) {
+        if (place[p] != t->place[side][0][p])
+            return (tk_fail(t, EC_RANGE, "the agents' strategies regroup %s schedule %d unlike schedule 0: "
+                                         "agent %d would take agent %d's place",
+                            side == 0 ? "demand" : "supply", k, place[p], t->place[side][0][p]));
     }
+    return (EC_OK);
+}
 
-    pi = &i;
-    pf = &f;
+// ec-parse: parse a mapped experiment file
+static int ec_parse(Tok *t, Expctl *ec, int verbose) {
+    int i, sched, code;
 
     /*read id string*/
-    if (get_non_comment_line(fp) != EOF) { /*copy id string up to but not including the newline*/
-        fscanf(fp, "%s\n", &(ec->id));
-        if (verbose) {
-            fprintf(stdout, "ID: %s\n", ec->id);
-            fflush(stdout);
+    if ((code = tk_word(t, ec->id, MAX_ID, "the id string")) != EC_OK) return (code);
+    if (verbose) fprintf(stdout, "ID: %s\n", ec->id);
+
+    if ((code = tk_int(t, &(ec->n_days), 1, MAX_N_DAYS, "# trading days")) != EC_OK) return (code);
+    if (verbose) fprintf(stdout, "%d days: ", ec->n_days);
+
+    if ((code = tk_int(t, &(ec->min_trades), 1, MAX_TRADES, "min # trades")) != EC_OK) return (code);
+    if (verbose) fprintf(stdout, "min_trades=%d ", ec->min_trades);
+
+    if ((code = tk_int(t, &(ec->max_trades), ec->min_trades, MAX_TRADES, "max # trades")) != EC_OK) return (code);
+    if (verbose) fprintf(stdout, "max_trades=%d\n", ec->max_trades);
+
+    /*read random flag*/
+    if ((code = tk_int(t, &(ec->random), 0, MAX_STRAT - 1, "random flag (0 ZIP, 1 ZI-C, 2 ZI-U)")) != EC_OK)
+        return (code);
+    if (verbose) {
+        switch (ec->random) {
+            case 2:
+                fprintf(stdout, "Random unconstrained (ZI-U) traders; ");
+                break;
+            case 1:
+                fprintf(stdout, "Random (ZI-C) traders; ");
+                break;
+            default:
+                fprintf(stdout, "Intelligent traders; ");
         }
     }
 
-
-    /*read number of days*/
-    if (get_non_comment_line(fp) != EOF) {
-        if (fscanf(fp, "%d", pi) != EOF) {
-            ec->n_days = (*pi);
-            if ((ec->n_days < 1) || (ec->n_days > MAX_N_DAYS)) {
-                fprintf(stderr, "\nFail: # trading days must be in range {1,...,%d}\n",
-                        MAX_N_DAYS);
-                exit(0);
-            }
-            if (verbose) {
-                fprintf(stdout, "%d days: ", ec->n_days);
-                fflush(stdout);
-            }
-        } else {
-            fprintf(stderr, "\nFail: can't read number of days\n");
-            exit(0);
+    /*read nyse flag, which gives the market rules*/
+    if ((code = tk_int(t, &(ec->nyse), RULES_PLAIN, RULES_BOOK,
+                       "NYSE flag (0 off, 1 on, 2 call market, 3 order book)")) != EC_OK)
+        return (code);
+    if (verbose) {
+        switch (ec->nyse) {
+            case RULES_BOOK:
+                fprintf(stdout, "limit order book\n");
+                break;
+            case RULES_CALL:
+                fprintf(stdout, "call market\n");
+                break;
+            case RULES_NYSE:
+                fprintf(stdout, "NYSE trading rules\n");
+                break;
+            default:
+                fprintf(stdout, "no NYSE rules\n");
         }
-    } else {
-        fprintf(stderr, "\nFail: EOF reading number of days\n");
-        exit(0);
     }
 
-    /*read min number of trades per day*/
-    if (get_non_comment_line(fp) != EOF) {
-        if (fscanf(fp, "%d", pi) != EOF) {
-            ec->min_trades = (*pi);
-            if ((ec->min_trades < 1) || (ec->min_trades > MAX_TRADES)) {
-                fprintf(stderr, "\nFail: min # trades must be in range {1,...,%d}\n",
-                        MAX_TRADES);
-                exit(0);
-            }
-            if (verbose) {
-                fprintf(stdout, "min_trades=%d ", ec->min_trades);
-                fflush(stdout);
-            }
-        } else {
-            fprintf(stderr, "\nFail: can't read min_trades\n");
-            exit(0);
-        }
-    } else {
-        fprintf(stderr, "\nFail: EOF reading min_trades\n");
-        exit(0);
+    /*read the demand schedules*/
+    if ((code = tk_int(t, &(ec->n_dem_sched), 1, MAX_SCHED, "# demand schedules")) != EC_OK) return (code);
+    if (verbose) fprintf(stdout, "%d demand schedules:\n", ec->n_dem_sched);
+    for (sched = 0; sched < ec->n_dem_sched; sched++) {
+        if (verbose) fprintf(stdout, " Demand schedule %d:\n", sched);
+        if ((code = read_sched(t, ec, 0, sched, ec->random, verbose)) != EC_OK) return (code);
+        t->n_dem = sched + 1;
     }
+    ec->d_sched = 0;
+    ec->dem_sched[ec->d_sched].first_day = 0;
 
-    /*read max number of trades per day*/
-    if (get_non_comment_line(fp) != EOF) {
-        if (fscanf(fp, "%d", pi) != EOF) {
-            ec->max_trades = (*pi);
-            if ((ec->max_trades < ec->min_trades) || (ec->max_trades > MAX_TRADES)) {
-                fprintf(stderr, "\nFail: max # trades muts be in range {%d,...,%d}\n",
-                        ec->min_trades, MAX_TRADES);
-                exit(0);
-            }
-            if (verbose) {
-                fprintf(stdout, "max_trades=%d\n", ec->max_trades);
-                fflush(stdout);
-            }
-        } else {
-            fprintf(stderr, "\nFail: can't read max_trades\n");
-            exit(0);
-        }
-    } else {
-        fprintf(stderr, "\nFail: EOF reading max_trades\n");
-        exit(0);
+    /*read the supply schedules*/
+    if ((code = tk_int(t, &(ec->n_sup_sched), 1, MAX_SCHED, "# supply schedules")) != EC_OK) return (code);
+    if (verbose) fprintf(stdout, "%d supply schedules:\n", ec->n_sup_sched);
+    for (sched = 0; sched < ec->n_sup_sched; sched++) {
+        if (verbose) fprintf(stdout, " Supply schedule %d:\n", sched);
+        if ((code = read_sched(t, ec, 1, sched, ec->random, verbose)) != EC_OK) return (code);
+        t->n_sup = sched + 1;
     }
+    ec->s_sched = 0;
+    ec->sup_sched[ec->s_sched].first_day = 0;
 
-    /*read random ag*/
-    if (get_non_comment_line(fp) != EOF) {
-        if (fscanf(fp, "%d", pi) != EOF) {
-            ec->random = (*pi);
-            switch (ec->random) {
-                case 1:
-                    if (verbose) fprintf(stdout, "Random (ZI-C) traders; ");
-                    break;
-
-                case 0:
-                    if (verbose) fprintf(stdout, "Intelligent traders; ");
-                    break;
+    /*anything after the last schedule is ignored, as it always was: files keep spare schedules there*/
 
+    /*which strategies are in the market?*/
+    ec->strat_mask = 0;
+    for (sched = 0; sched < ec->n_dem_sched; sched++) {
+        for (i = 0; i < ec->dem_sched[sched].n_part; i++)
+            ec->strat_mask |= (1 << ec->dem_sched[sched].part[i].strategy);
+    }
+    for (sched = 0; sched < ec->n_sup_sched; sched++) {
+        for (i = 0; i < ec->sup_sched[sched].n_part; i++)
+            ec->strat_mask |= (1 << ec->sup_sched[sched].part[i].strategy);
+    }
+    return (EC_OK);
+}
 
-                default:
-                    fprintf(stderr, "\nFail: random flag must be boolean\n");
-                    exit(0);
+// expctl-top: the highest price a trader of an experiment could quote, given the ZIP learning parameters zp and
+// every agent's strategy (or each agent's own, if strategy is -1). A ZI trader quotes no higher than RMAX, and
+// a ZIP seller opens at its highest margin and learns from deals, which a buyer makes at no more than its limit
+// (or RMAX, for ZI-U), aiming a mark-up above them
+Real expctl_top(Expctl *ec, Zip_params *zp, int strategy) {
+    int s, a, u, st;
+    Real q, top = 0.0;
+    SD_sched *sched;
+
+    for (s = 0; s < ec->n_dem_sched + ec->n_sup_sched; s++) {
+        sched = (s < ec->n_dem_sched ? ec->dem_sched + s : ec->sup_sched + s - ec->n_dem_sched);
+        for (a = 0; a < sched->n_agents; a++) {
+            st = (strategy < 0 ? sched->agents[a].strategy : strategy);
+            for (u = 0; u < sched->agents[a].n_units; u++) {
+                q = PRICE(sched->agents[a].limit[u]);
+                if (s < ec->n_dem_sched) q = ((st == ST_ZIU ? RMAX : q) * (1 + zp->mark)) + zp->mark_abs;
+                else if (st == ST_ZIP) q *= (1 + zp->profit_min + zp->profit_range);
+                else q = RMAX;
+                if (q > top) top = q;
             }
-            if (verbose) fflush(stdout);
-        } else {
-            fprintf(stderr, "\nFail: can't read random flag\n");
-            exit(0);
         }
-    } else {
-        fprintf(stderr, "\nFail: EOF reading random flag\n");
-        exit(0);
     }
+    return (top);
+}
 
-    /*read nyse ag*/
-    if (get_non_comment_line(fp) != EOF) {
-        if (fscanf(fp, "%d", pi) != EOF) {
-            ec->nyse = (*pi);
-            switch (ec->nyse) {
-                case 1:
-                    if (verbose) fprintf(stdout, "NYSE trading rules\n");
-                    break;
-
-                case 0:
-                    if (verbose) fprintf(stdout, "no NYSE rules\n");
-                    break;
-
-                default:
-                    fprintf(stderr, "\nFail: NYSE flag must be boolean\n");
-                    exit(0);
-            }
-            if (verbose) fflush(stdout);
-        } else {
-            fprintf(stderr, "\nFail: can't read nyse flag\n");
-            exit(0);
+// expctl-check: check that an experiment can run all its days: that its schedules last that long, that on no
+// day are both sides silent, that no ZI-C trader's limit price is beyond the range it quotes in and, with an
+// order book, that no price the traders could quote with learning parameters zp is off the book's grid. A
+// strategy other than -1 is checked as every agent's, as a sweep or a served request can make it. Returns
+// EC_OK, or EC_RANGE with the problem described in err
+int expctl_check(Expctl *ec, Zip_params *zp, int strategy, char name[], char err[], int errlen) {
+    int d, s, a, u, dem = 0, sup = 0;
+    Real top;
+    SD_sched *sched;
+
+    for (d = 0; d < ec->n_days; d++) { /*moving on from schedule to schedule as market.c's day_init() does*/
+        if ((d > 0) && ((d - 1) == ec->dem_sched[dem].last_day)) dem++;
+        if ((d > 0) && ((d - 1) == ec->sup_sched[sup].last_day)) sup++;
+        if ((dem == ec->n_dem_sched) || (sup == ec->n_sup_sched)) {
+            snprintf(err, errlen, "%s: the %s schedules run out on day %d of %d", name,
+                     (dem == ec->n_dem_sched ? "demand" : "supply"), d, ec->n_days);
+            return (EC_RANGE);
+        }
+        if ((!ec->dem_sched[dem].can_shout) && (!ec->sup_sched[sup].can_shout)) {
+            snprintf(err, errlen, "%s: both buyers and sellers are silent on day %d", name, d);
+            return (EC_RANGE);
         }
-    } else {
-        fprintf(stderr, "\nFail: EOF reading nyse flag\n");
-        exit(0);
     }
-
-    /*read number of demand schedules*/
-    if (get_non_comment_line(fp) != EOF) {
-        if (fscanf(fp, "%d", pi) != EOF) {
-            ec->n_dem_sched = (*pi);
-            if ((ec->n_dem_sched < 1) || (ec->n_dem_sched > MAX_SCHED)) {
-                fprintf(stderr, "\nFail: # demand scheds must be in range {1,...,%d}\n",
-                        MAX_SCHED);
-                exit(0);
-            }
-
-            if (verbose) {
-                fprintf(stdout, "%d demand schedules:\n", ec->n_dem_sched);
-                fflush(stdout);
+    for (s = 0; s < ec->n_dem_sched + ec->n_sup_sched; s++) {
+        sched = (s < ec->n_dem_sched ? ec->dem_sched + s : ec->sup_sched + s - ec->n_dem_sched);
+        for (a = 0; a < sched->n_agents; a++) {
+            if ((strategy < 0 ? sched->agents[a].strategy : strategy) != ST_ZIC) continue;
+            for (u = 0; u < sched->agents[a].n_units; u++) {
+                if (PRICE(sched->agents[a].limit[u]) > RMAX) {
+                    snprintf(err, errlen, "%s: a ZI-C trader's limit price %g is above RMAX=%g", name,
+                             PRICE(sched->agents[a].limit[u]), RMAX);
+                    return (EC_RANGE);
+                }
             }
-        } else {
-            fprintf(stderr, "\nFail: can't read # demand schedules\n");
-            exit(0);
         }
-    } else {
-        fprintf(stderr, "\nFail: EOF reading # demand schedules\n");
-        exit(0);
     }
-
-    /*read the schedules*/
-    for (sched = 0; sched < ec->n_dem_sched; sched++) {
-        if (verbose) fprintf(stdout, " Demand schedule %d:\n", sched);
-        if (read_sched(fp, &(ec->dem_sched[sched]), verbose) == EOF) {
-            fprintf(stderr, "\nFail: no more demand schedules\n");
-            exit(0);
-        }
+    if ((ec->nyse == RULES_BOOK) && (CENTS(top = expctl_top(ec, zp, strategy)) >= BOOK_TICKS)) {
+        snprintf(err, errlen, "%s: prices could reach %g, off the order book's grid of %d cents (build with "
+                              "-DBOOK_TICKS=n for a wider one)", name, top, BOOK_TICKS);
+        return (EC_RANGE);
     }
+    return (EC_OK);
+}
 
-    ec->d_sched = 0;
-    ec->dem_sched[ec->d_sched].first_day = 0;
+// ec-text: parse an experiment file's text, len bytes at buf, into newly allocated schedules
+static int ec_text(const char *buf, long len, char name[], Expctl *ec, int verbose, char err[], int errlen) {
+    Tok t;
+    int code;
+
+    t.fname = name;
+    t.err = err;
+    t.errlen = errlen;
+    t.line = t.tok_line = t.tok_col = 1;
+    t.a = t.u = t.n_dem = t.n_sup = 0;
+    if (len == 0) return (tk_fail(&t, EC_EOF, "the file is empty"));
+    if ((ec->block = malloc(2 * MAX_SCHED * sizeof(SD_sched))) == NULL) {
+        snprintf(err, errlen, "%s: can't allocate its schedules", name);
+        return (EC_NOMEM);
+    }
+    ec->block_size = 0;
+    ec->dem_sched = ec->block;
+    ec->sup_sched = ec->dem_sched + MAX_SCHED;
+
+    t.p = t.line_start = buf;
+    t.end = t.p + len;
+    code = ec_parse(&t, ec, verbose);
+    if (verbose) fflush(stdout);
+    if (code == EC_OK) code = expctl_check(ec, &zip_defaults, -1, name, err, errlen);
+
+    if (code != EC_OK) expctl_free(ec);
+    return (code);
+}
 
+// ec-image-note: say what an image holds
+static void ec_image_note(Expctl *ec) {
+    fprintf(stdout, "ID: %s (compiled image)\n%d days: min_trades=%d max_trades=%d\n", ec->id, ec->n_days,
+            ec->min_trades, ec->max_trades);
+    fprintf(stdout, "%d demand and %d supply schedules\n", ec->n_dem_sched, ec->n_sup_sched);
+}
 
-    /*read number of supply schedules*/
-    if (get_non_comment_line(fp) != EOF) {
-        if (fscanf(fp, "%d", pi) != EOF) {
-            ec->n_sup_sched = (*pi);
-            if ((ec->n_sup_sched < 1) || (ec->n_sup_sched > MAX_SCHED)) {
-                fprintf(stderr, "\nFail: # supply scheds must be in range {1,...,%d}\n",
-                        MAX_SCHED);
-                exit(0);
-            }
+// expctl-parse-mem: read expctl data from len bytes at buf, the text of an experiment file or an image, naming it
+// name in messages; an image is copied, so buf needn't outlive the Expctl. Returns as expctl_parse()
+int expctl_parse_mem(const char *buf, long len, char name[], Expctl *ec, int verbose, char err[], int errlen) {
+    int code;
+    char *copy;
 
-            if (verbose) {
-                fprintf(stdout, "%d supply schedules:\n", ec->n_sup_sched);
-                fflush(stdout);
-            }
-        } else {
-            fprintf(stderr, "\nFail: can't read # supply schedules\n");
-            exit(0);
+    if ((len >= 8) && (memcmp(buf, IMAGE_MAGIC, 8) == 0)) {
+        if ((copy = malloc(len)) == NULL) {
+            snprintf(err, errlen, "%s: can't allocate a copy of the image", name);
+            return (EC_NOMEM);
         }
-    } else {
-        fprintf(stderr, "\nFail: EOF reading # supply schedules\n");
-        exit(0);
+        memcpy(copy, buf, len);
+        if ((code = image_map(copy, len, name, ec, err, errlen)) != EC_OK) {
+            free(copy);
+            return (code);
+        }
+        ec->block = copy;
+        ec->block_size = 0;
+        if (verbose) ec_image_note(ec);
+        return (EC_OK);
     }
+    return (ec_text(buf, len, name, ec, verbose, err, errlen));
+}
 
-    /*read the schedules*/
-    for (sched = 0; sched < ec->n_sup_sched; sched++) {
-        if (verbose) fprintf(stdout, " Supply schedule %d:\n", sched);
-        if (read_sched(fp, &(ec->sup_sched[sched]), verbose) == EOF) {
-            fprintf(stderr, "\nFail: no more supply schedules\n");
-            exit(0);
-        }
+// expctl-parse: read expctl data from a specified file, or map it if it is an image; returns EC_OK, or an error
+// code with the first error described as file:line:column: message in err
+int expctl_parse(char filename[], Expctl *ec, int verbose, char err[], int errlen) {
+    struct stat st;
+    void *map;
+    int fd, code;
+
+    if (((fd = open(filename, O_RDONLY)) < 0) || (fstat(fd, &st) != 0)) {
+        snprintf(err, errlen, "%s: can't open as expctl input file (%s)", filename, strerror(errno));
+        if (fd >= 0) close(fd);
+        return (EC_OPEN);
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return (ec_text("", 0, filename, ec, verbose, err, errlen));
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        snprintf(err, errlen, "%s: can't map the file (%s)", filename, strerror(errno));
+        return (EC_OPEN);
     }
 
-    ec->s_sched = 0;
-    ec->sup_sched[ec->s_sched].first_day = 0;
+    if ((st.st_size >= 8) && (memcmp(map, IMAGE_MAGIC, 8) == 0)) { /*an image: keep it mapped, and share it*/
+        if ((code = image_map(map, st.st_size, filename, ec, err, errlen)) != EC_OK) {
+            munmap(map, st.st_size);
+            return (code);
+        }
+        ec->block = map;
+        ec->block_size = st.st_size;
+        if (verbose) ec_image_note(ec);
+        return (EC_OK);
+    }
 
-    fclose(fp);
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    code = ec_text(map, st.st_size, filename, ec, verbose, err, errlen);
+    munmap(map, st.st_size);
+    return (code);
 }
 
+// expctl-in: read expctl data from a specified file, giving up if anything is wrong with it
+void expctl_in(char filename[], Expctl *ec, int verbose) {
+    char err[256];
+
+    if (expctl_parse(filename, ec, verbose, err, sizeof(err)) != EC_OK) {
+        fprintf(stderr, "\nFail: %s\n", err);
+        exit(0);
+    }
+}
 
+// expctl-free: release an experiment's schedules; copies of the Expctl share them, so must not be used after
+void expctl_free(Expctl *ec) {
+    if (ec->block_size > 0) munmap(ec->block, ec->block_size);
+    else free(ec->block);
+    ec->block = NULL;
+    ec->block_size = 0;
+    ec->dem_sched = ec->sup_sched = NULL;
+}
@@ -4,32 +4,76 @@
 // Agent-sched: data associated with one agent's buy/sell limits etc
 typedef struct an_agent_sched {
     int n_units;           /*how many units the agent         has/wants*/
-    Real limit[MAX_UNITS]; /*limit price of each unit*/
+    Cents limit[MAX_UNITS]; /*limit price of each unit*/
+    int strategy;          /*what kind of trader: index into strategies[]*/
 } Agent_sched;
 
+// Partition: a run of agents in a schedule that all use the same strategy
+typedef struct a_partition {
+    int strategy;          /*index into strategies[]*/
+    int first;             /*index of the first agent in the run*/
+    int n;                 /*number of agents in the run*/
+} Partition;
+
 // SD-sched: data associated with a supply or demand schedule
 typedef struct sd_sched {
     int n_agents;                        /*how many agents involved*/
     int first_day;                       /*first day this schedule applies to*/
     int last_day;                        /*last day this schedule applies to*/
     int can_shout;                       /*boolean: 0=>silent traders; 1=>can    shout*/
-    Agent_sched agents[MAX_AGENTS];      /*details of individual agents*/
+    Agent_sched agents[MAX_AGENTS];      /*details of individual agents, grouped by strategy*/
+    int n_part;                          /*number of strategy partitions*/
+    Partition part[MAX_STRAT];           /*the agents of each strategy, in agents[] order*/
 } SD_sched;
 
+// symbolic constants for the market rules, given by the experiment file's nyse flag
+#define RULES_PLAIN 0 /*continuous double auction*/
+#define RULES_NYSE  1 /*continuous, with the NYSE rule that each shout must improve on the best so far*/
+#define RULES_CALL  2 /*periodic call market: everyone quotes, and the quotes are cleared together*/
+#define RULES_BOOK  3 /*continuous, with shouts standing as orders in a limit order book (book.h)*/
+
 // Expctl: experiment control parameters
 typedef struct a_expctl {
     char id[MAX_ID];                    /*id characters for output files*/
     int n_days;                         /*number of trading periods to run for*/
     int min_trades;                     /*minimum number of trades per day*/
     int max_trades;                     /*maximum number of trades per day*/
-    int random;                         /*boolean: 0=> ZIP; 1=>ZI-C*/
-    int nyse;                           /*boolean: 0=>NYSE o ; 1=>NYSE on*/
+    int random;                         /*strategy: 0=> ZIP; 1=>ZI-C; 2=>ZI-U*/
+    int nyse;                           /*market rules: RULES_...*/
     int n_dem_sched;                    /*number of demand schedules*/
-    SD_sched dem_sched[MAX_SCHED];      /*details of demand schedules*/
+    SD_sched *dem_sched;                /*details of demand schedules: read-only if mapped from an image*/
     int d_sched;                        /*index of currently active demand schedule*/
     int n_sup_sched;                    /*number of supply schedules*/
-    SD_sched sup_sched[MAX_SCHED];      /*details of supply schedules*/
+    SD_sched *sup_sched;                /*details of supply schedules: likewise*/
     int s_sched;                        /*index of currently active supply schedule*/
+    int strat_mask;                     /*bit s set => some agent uses strategy s*/
+    void *block;                        /*the memory the schedules are in: malloc'd, or a mapped image*/
+    long block_size;                    /*the size of a mapped image; 0 => malloc'd*/
+    int keyed;                          /*boolean: agents draw from per-agent keyed streams (smith -j)*/
+    Shout_key key;                      /*the current experiment and shout, when keyed*/
 } Expctl;
 
+// symbolic constants for what expctl_parse() can find wrong with an experiment file
+#define EC_OK       0
+#define EC_OPEN     1 /*can't open or map it*/
+#define EC_EOF      2 /*it ends too soon*/
+#define EC_SYNTAX   3 /*not a number where one should be, or text where none should be*/
+#define EC_RANGE    4 /*a value out of range*/
+#define EC_STRATEGY 5 /*an unknown strategy name*/
+#define EC_IMAGE    6 /*an image from a different build, or damaged*/
+#define EC_NOMEM    7 /*out of memory*/
+#define EC_ARG      8 /*a bad argument to a libzip function (see libzip.h)*/
+
+int expctl_parse(char [], Expctl *, int, char [], int);
+
+int expctl_parse_mem(const char *, long, char [], Expctl *, int, char [], int);
+
+Real expctl_top(Expctl *, Zip_params *, int);
+
+int expctl_check(Expctl *, Zip_params *, int, char [], char [], int);
+
 void expctl_in(char [], Expctl *, int);
+
+void expctl_free(Expctl *);
+
+int partition_sched(SD_sched *);
@@ -0,0 +1,185 @@
+//
+// image.c: compile an experiment into a binary image, and map an image back in (see image.h)
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "expctl.h"
+#include "image.h"
+
+// im-round: round an offset up to the next part of an image
+static long im_round(long off) {
+    return (((off + IMAGE_ALIGN - 1) / IMAGE_ALIGN) * IMAGE_ALIGN);
+}
+
+// im-head: the header of an image of an experiment for this build
+static void im_head(Image_head *h, Expctl *ec) {
+    memset(h, 0, sizeof(Image_head));
+    memcpy(h->magic, IMAGE_MAGIC, 8);
+    h->version = IMAGE_VERSION;
+    h->endian = IMAGE_ENDIAN;
+    h->real_size = sizeof(Real);
+    h->max_agents = MAX_AGENTS;
+    h->max_units = MAX_UNITS;
+    h->max_sched = MAX_SCHED;
+    h->max_strat = MAX_STRAT;
+    h->max_id = MAX_ID;
+    h->ec_size = sizeof(Expctl);
+    h->sched_size = sizeof(SD_sched);
+    h->ec_off = im_round(sizeof(Image_head));
+    h->dem_off = im_round(h->ec_off + sizeof(Expctl));
+    h->sup_off = im_round(h->dem_off + (long) ec->n_dem_sched * sizeof(SD_sched));
+    h->size = h->sup_off + (long) ec->n_sup_sched * sizeof(SD_sched);
+}
+
+// im-pad: write zeros up to offset off
+static void im_pad(FILE *fp, long off) {
+    while (ftell(fp) < off) fputc(0, fp);
+}
+
+// image-write: write an experiment read by expctl_in() to an image; returns EC_OK, or EC_OPEN with why in err
+int image_write(Expctl *ec, char fname[], char err[], int errlen) {
+    Image_head h;
+    static Expctl copy;
+    char tmp[FILENAME_MAX];
+    int fd, ok;
+    FILE *fp;
+
+    /*the copy in the image holds no pointers, and none of a run's state*/
+    memcpy(&copy, ec, sizeof(Expctl));
+    copy.dem_sched = copy.sup_sched = NULL;
+    copy.block = NULL;
+    copy.block_size = 0;
+    copy.d_sched = copy.s_sched = 0;
+    copy.keyed = 0;
+    memset(&(copy.key), 0, sizeof(Shout_key));
+    im_head(&h, ec);
+
+    /*written beside the image, then renamed over it, so a mapped image never changes underneath a reader*/
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", fname);
+    if (((fd = mkstemp(tmp)) < 0) || ((fp = fdopen(fd, "wb")) == NULL)) {
+        snprintf(err, errlen, "%s: can't write image", fname);
+        if (fd >= 0) close(fd);
+        return (EC_OPEN);
+    }
+    fchmod(fd, 0644); /*mkstemp() makes it private, but an image is for sharing*/
+    fwrite(&h, sizeof(h), 1, fp);
+    im_pad(fp, h.ec_off);
+    fwrite(&copy, sizeof(Expctl), 1, fp);
+    im_pad(fp, h.dem_off);
+    fwrite(ec->dem_sched, sizeof(SD_sched), ec->n_dem_sched, fp);
+    im_pad(fp, h.sup_off);
+    fwrite(ec->sup_sched, sizeof(SD_sched), ec->n_sup_sched, fp);
+    ok = ((fflush(fp) == 0) && (!ferror(fp)));
+    if ((fclose(fp) != 0) || (!ok) || (rename(tmp, fname) != 0)) {
+        unlink(tmp);
+        snprintf(err, errlen, "%s: couldn't write image", fname);
+        return (EC_OPEN);
+    }
+    return (EC_OK);
+}
+
+// im-sched-ok: is a schedule in an image one the parser could have made? Every agent is checked, since the
+// market indexes its tables by agents' units and strategies
+static int im_sched_ok(const SD_sched *sched) {
+    int a, u, p, n = 0;
+    const Agent_sched *as;
+
+    if ((sched->n_agents < 1) || (sched->n_agents > MAX_AGENTS) || (sched->n_part < 1) ||
+        (sched->n_part > MAX_STRAT) || (sched->first_day < 0) || (sched->last_day < sched->first_day) ||
+        (sched->last_day > MAX_N_DAYS) || ((sched->can_shout != 0) && (sched->can_shout != 1)))
+        return (0);
+    for (p = 0; p < sched->n_part; p++) { /*the partitions must tile the agents, in order*/
+        if ((sched->part[p].first != n) || (sched->part[p].n < 1) || (sched->part[p].strategy < 0) ||
+            (sched->part[p].strategy >= MAX_STRAT))
+            return (0);
+        n += sched->part[p].n;
+        if (n > sched->n_agents) return (0);
+        for (a = sched->part[p].first; a < n; a++) {
+            as = sched->agents + a;
+            if ((as->strategy != sched->part[p].strategy) || (as->n_units < 1) || (as->n_units > MAX_UNITS))
+                return (0);
+            for (u = 0; u < as->n_units; u++) {
+                if ((as->limit[u] < 0) || (as->limit[u] > CENTS(PRICE_MAX))) return (0);
+            }
+        }
+    }
+    return (n == sched->n_agents);
+}
+
+// image-map: set up an Expctl from an image mapped at map, size bytes long; the schedules are left in the image,
+// so they must not be written to. The image is checked as thoroughly as a file is parsed, since it may not have
+// been written by image_write(). Returns EC_OK, EC_IMAGE if it is damaged or EC_RANGE if it can't run, with why
+// in err
+int image_map(const void *map, long size, char fname[], Expctl *ec, char err[], int errlen) {
+    Image_head h;
+    const char *base = map;
+    int s, p;
+
+    if (size < (long) sizeof(Image_head)) {
+        snprintf(err, errlen, "%s: image is cut short", fname);
+        return (EC_IMAGE);
+    }
+    memcpy(&h, base, sizeof(Image_head));
+    if (h.version != IMAGE_VERSION) {
+        snprintf(err, errlen, "%s: image is version %d, not %d: compile it again", fname, h.version, IMAGE_VERSION);
+        return (EC_IMAGE);
+    }
+    if ((h.endian != IMAGE_ENDIAN) || (h.real_size != sizeof(Real)) || (h.max_agents != MAX_AGENTS) ||
+        (h.max_units != MAX_UNITS) || (h.max_sched != MAX_SCHED) || (h.max_strat != MAX_STRAT) ||
+        (h.max_id != MAX_ID) || (h.ec_size != sizeof(Expctl)) || (h.sched_size != sizeof(SD_sched))) {
+        snprintf(err, errlen, "%s: image was compiled by a build with different Real or array bounds", fname);
+        return (EC_IMAGE);
+    }
+    if ((h.size != size) || (h.ec_off % IMAGE_ALIGN) || (h.dem_off % IMAGE_ALIGN) || (h.sup_off % IMAGE_ALIGN) ||
+        (h.ec_off < (long) sizeof(Image_head)) || (h.ec_off + (long) sizeof(Expctl) > size)) {
+        snprintf(err, errlen, "%s: image is damaged or cut short", fname);
+        return (EC_IMAGE);
+    }
+
+    memcpy(ec, base + h.ec_off, sizeof(Expctl));
+    ec->id[MAX_ID - 1] = '\0';
+    if ((ec->n_days < 1) || (ec->n_days > MAX_N_DAYS) || (ec->min_trades < 1) || (ec->min_trades > MAX_TRADES) ||
+        (ec->max_trades < ec->min_trades) || (ec->max_trades > MAX_TRADES) || (ec->random < 0) ||
+        (ec->random >= MAX_STRAT) || (ec->nyse < RULES_PLAIN) || (ec->nyse > RULES_BOOK)) {
+        snprintf(err, errlen, "%s: image's settings are damaged", fname);
+        return (EC_IMAGE);
+    }
+    if ((ec->n_dem_sched < 1) || (ec->n_dem_sched > MAX_SCHED) || (ec->n_sup_sched < 1) ||
+        (ec->n_sup_sched > MAX_SCHED) || (h.dem_off < h.ec_off + (long) sizeof(Expctl)) ||
+        (h.dem_off + (long) ec->n_dem_sched * (long) sizeof(SD_sched) > h.sup_off) ||
+        (h.sup_off + (long) ec->n_sup_sched * (long) sizeof(SD_sched) != size)) {
+        snprintf(err, errlen, "%s: image is damaged", fname);
+        return (EC_IMAGE);
+    }
+    ec->dem_sched = (SD_sched *) (base + h.dem_off); /*mapped read-only: a write would fault*/
+    ec->sup_sched = (SD_sched *) (base + h.sup_off);
+    for (s = 0; s < ec->n_dem_sched; s++) {
+        if (!im_sched_ok(ec->dem_sched + s)) {
+            snprintf(err, errlen, "%s: image's demand schedule %d is damaged", fname, s);
+            return (EC_IMAGE);
+        }
+    }
+    for (s = 0; s < ec->n_sup_sched; s++) {
+        if (!im_sched_ok(ec->sup_sched + s)) {
+            snprintf(err, errlen, "%s: image's supply schedule %d is damaged", fname, s);
+            return (EC_IMAGE);
+        }
+    }
+    ec->strat_mask = 0; /*from the schedules themselves*/
+    for (s = 0; s < ec->n_dem_sched; s++) {
+        for (p = 0; p < ec->dem_sched[s].n_part; p++) ec->strat_mask |= (1 << ec->dem_sched[s].part[p].strategy);
+    }
+    for (s = 0; s < ec->n_sup_sched; s++) {
+        for (p = 0; p < ec->sup_sched[s].n_part; p++) ec->strat_mask |= (1 << ec->sup_sched[s].part[p].strategy);
+    }
+    return (expctl_check(ec, &zip_defaults, -1, fname, err, errlen)); /*as a file's text is, once parsed*/
+}
@@ -0,0 +1,28 @@
+//
+// image.h: an experiment compiled into a binary image, for mapping read-only and sharing between processes
+//
+// "smith compile datafile imagefile" checks an experiment file once and writes its Expctl and schedules to an
+// image. Where they are in it is recorded as offsets, not pointers, so the image can be mapped at any address;
+// expctl_in() maps an image instead of parsing it, and every process that maps it shares the one copy.
+
+#define IMAGE_MAGIC   "ZIPIMG01"
+#define IMAGE_VERSION 2          /*raise whenever what an image holds changes*/
+#define IMAGE_ENDIAN  0x01020304 /*as written by the machine that wrote the image*/
+#define IMAGE_ALIGN   64         /*each part of an image starts on a multiple of this*/
+
+// Image-head: the header of an image, which must match the build reading it
+typedef struct an_image_head {
+    char magic[8];
+    int version;
+    int endian;
+    int real_size;                /*sizeof(Real)*/
+    int max_agents, max_units, max_sched, max_strat, max_id; /*the writer's array bounds*/
+    int ec_size, sched_size;      /*sizeof(Expctl), sizeof(SD_sched)*/
+    long ec_off;                  /*where the Expctl is*/
+    long dem_off, sup_off;        /*where the demand and supply schedules start*/
+    long size;                    /*the size of the whole image*/
+} Image_head;
+
+int image_write(Expctl *, char [], char [], int);
+
+int image_map(const void *, long, char [], Expctl *, char [], int);
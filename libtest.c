@@ -0,0 +1,122 @@
+//
+// libtest.c: check libzip: two contexts run at once on different threads must agree with each other, and
+// their graphs with those of smith -e; bad arguments and bad experiments must be refused with the right
+// code, leaving what was loaded before. "libtest datafile n_exps" writes the graphs of a run of n_exps
+// experiments of datafile to the current directory, for "make check" to compare with smith's
+//
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libzip.h"
+#include "tdat.h"
+#include "strategy.h"
+#include "book.h"
+#include "market.h"
+
+#define LT_SEED 999 /*the seed smith gives a run of more than one experiment*/
+
+// Lt-job: one context's run, on a thread of its own
+typedef struct lt_job {
+    Zip_ctx *z;
+    int n_exps;
+    int code;
+    Zip_results res;
+} Lt_job;
+
+static Lt_job job[2]; /*static: too big for the stack*/
+static Zip_results again;
+
+static char zic_high[] = /*a ZI-C buyer whose limit is above RMAX*/
+        "zic\n3\n1\n5\n1\n0\n"
+        "1\n2\n0\n2\n1\n1 5.00\n1 1.00\n"
+        "1\n2\n0\n2\n1\n1 0.50\n1 1.00\n";
+
+// lt-run: run a job's experiments
+static void *lt_run(void *arg) {
+    Lt_job *j = arg;
+
+    j->code = zip_ctx_run(j->z, j->n_exps, LT_SEED, &(j->res));
+    return (NULL);
+}
+
+// lt-read: the whole of a file, in newly allocated memory
+static char *lt_read(char fname[], long *len) {
+    FILE *fp;
+    char *buf;
+
+    assert((fp = fopen(fname, "rb")) != NULL);
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    rewind(fp);
+    assert((buf = malloc(*len + 1)) != NULL);
+    assert(fread(buf, 1, *len, fp) == (size_t) *len);
+    fclose(fp);
+    return (buf);
+}
+
+int main(int argc, char *argv[]) {
+    pthread_t th[2];
+    char *text;
+    long len;
+    int k, n_exps;
+    Zip_params zp = zip_defaults;
+    Zip_results *r = &(job[0].res);
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s datafile n_exps\n", argv[0]);
+        return (1);
+    }
+    n_exps = atoi(argv[2]);
+    text = lt_read(argv[1], &len);
+
+    /*bad arguments*/
+    assert(zip_ctx_load(NULL, text, len) == EC_ARG);
+    assert(zip_ctx_run(NULL, 1, LT_SEED, &again) == EC_ARG);
+    assert((job[0].z = zip_ctx_new()) != NULL);
+    assert((job[1].z = zip_ctx_new()) != NULL);
+    assert(zip_ctx_load(job[0].z, NULL, 0) == EC_ARG);
+    assert(zip_ctx_load(job[0].z, text, -1) == EC_ARG);
+    assert(zip_ctx_run(job[0].z, 1, LT_SEED, &again) == EC_ARG); /*nothing loaded yet*/
+    assert(strlen(zip_ctx_error(job[0].z)) > 0);
+
+    /*one context from the text, the other from the file*/
+    assert(zip_ctx_load(job[0].z, text, len) == EC_OK);
+    assert(zip_ctx_load_file(job[1].z, argv[1]) == EC_OK);
+    assert(zip_ctx_run(job[0].z, 0, LT_SEED, &again) == EC_ARG);
+    zp.mark = -1.0;
+    assert(zip_ctx_params(job[0].z, &zp) == EC_RANGE);
+    assert(zip_ctx_params(job[0].z, NULL) == EC_ARG);
+
+    /*bad loads are refused, and leave the experiment loaded before*/
+    assert(zip_ctx_load(job[1].z, zic_high, strlen(zic_high)) == EC_RANGE);
+    assert(zip_ctx_load(job[1].z, text, len / 2) != EC_OK);
+    assert(zip_ctx_load(job[1].z, "", 0) == EC_EOF);
+    assert(zip_ctx_load_file(job[1].z, "no/such/experiment.dat") == EC_OPEN);
+    fprintf(stdout, "libzip: bad arguments and bad experiments refused\n");
+
+    /*both at once: the contexts share nothing, so they must agree exactly*/
+    for (k = 0; k < 2; k++) {
+        job[k].n_exps = n_exps;
+        assert(pthread_create(th + k, NULL, lt_run, job + k) == 0);
+    }
+    for (k = 0; k < 2; k++) {
+        assert(pthread_join(th[k], NULL) == 0);
+        assert(job[k].code == EC_OK);
+    }
+    assert(memcmp(&(job[0].res), &(job[1].res), sizeof(Zip_results)) == 0);
+
+    /*and a context run again gives the same again*/
+    assert(zip_ctx_run(job[1].z, n_exps, LT_SEED, &again) == EC_OK);
+    assert(memcmp(&(job[0].res), &again, sizeof(Zip_results)) == 0);
+    fprintf(stdout, "libzip: two contexts on two threads agree\n");
+
+    run_graphs(r->id, r->n_days, r->max_trades, r->strat_mask, r->n_exps, r->day, r->trade);
+    zip_ctx_free(job[0].z);
+    zip_ctx_free(job[1].z);
+    free(text);
+    return (0);
+}
@@ -0,0 +1,137 @@
+//
+// libzip.c: the market as a library (see libzip.h)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libzip.h"
+#include "tdat.h"
+#include "strategy.h"
+#include "book.h"
+#include "market.h"
+
+#define ZC_ERRLEN 256
+
+// Zip-ctx: a context: an experiment and the state of runs on it
+struct a_zip_ctx {
+    Market m;                    /*the market, holding the experiment once one is loaded*/
+    int loaded;                  /*boolean: has an experiment been loaded?*/
+    Zip_params zp;               /*the learning parameters to run with*/
+    Ran1 rng;                    /*the generator, swapped in for the thread running the context*/
+    Exp_result r;                /*what the current experiment adds to the results*/
+    char err[ZC_ERRLEN];         /*what went wrong last*/
+};
+
+// zip-ctx-new: a new context, with no experiment loaded; NULL if out of memory
+Zip_ctx *zip_ctx_new(void) {
+    Zip_ctx *z;
+
+    if ((z = calloc(1, sizeof(Zip_ctx))) == NULL) return (NULL);
+    z->zp = zip_defaults;
+    rseed_r(&(z->rng), 0);
+    return (z);
+}
+
+// zip-ctx-free: free a context and its experiment
+void zip_ctx_free(Zip_ctx *z) {
+    if (z == NULL) return;
+    if (z->loaded) expctl_free(&(z->m.ec));
+    free(z);
+}
+
+// zc-loaded: take up a newly loaded experiment, or note that loading failed
+static int zc_loaded(Zip_ctx *z, int code, Expctl *ec) {
+    if (code != EC_OK) return (code);
+    if (z->loaded) expctl_free(&(z->m.ec));
+    z->m.ec = *ec;
+    z->loaded = 1;
+    z->err[0] = '\0';
+    return (EC_OK);
+}
+
+// zip-ctx-load: load an experiment from len bytes at text: an experiment file's contents, or an image from
+// "smith compile". Whatever was loaded before is replaced, unless this fails
+int zip_ctx_load(Zip_ctx *z, const char *text, long len) {
+    Expctl ec;
+
+    if ((z == NULL) || (text == NULL) || (len < 0)) return (EC_ARG);
+    memset(&ec, 0, sizeof(Expctl));
+    return (zc_loaded(z, expctl_parse_mem(text, len, "experiment", &ec, 0, z->err, ZC_ERRLEN), &ec));
+}
+
+// zip-ctx-load-file: load an experiment from a file, as zip_ctx_load()
+int zip_ctx_load_file(Zip_ctx *z, char fname[]) {
+    Expctl ec;
+
+    if ((z == NULL) || (fname == NULL)) return (EC_ARG);
+    memset(&ec, 0, sizeof(Expctl));
+    return (zc_loaded(z, expctl_parse(fname, &ec, 0, z->err, ZC_ERRLEN), &ec));
+}
+
+// zip-ctx-params: run with these ZIP learning parameters rather than the defaults (zip_defaults)
+int zip_ctx_params(Zip_ctx *z, Zip_params *zp) {
+    if ((z == NULL) || (zp == NULL)) return (EC_ARG);
+    if ((zp->mark < 0.0) || (zp->mark_abs < 0.0) || (zp->profit_range < 0.0) || (zp->beta_min < 0.0) ||
+        (zp->beta_range < 0.0) || (zp->mom_range < 0.0)) {
+        snprintf(z->err, ZC_ERRLEN, "learning parameters can't be negative, bar profit_min");
+        return (EC_RANGE);
+    }
+    z->zp = *zp;
+    return (EC_OK);
+}
+
+// zip-ctx-run: run n_exps independent experiments, experiment e seeded with seed+e, and sum their stats in res
+int zip_ctx_run(Zip_ctx *z, int n_exps, int seed, Zip_results *res) {
+    int d, t, e;
+    Ran1 caller;
+    Zip_params *caller_zp;
+    Market *m;
+
+    if ((z == NULL) || (res == NULL)) return (EC_ARG);
+    if (!(z->loaded)) {
+        snprintf(z->err, ZC_ERRLEN, "no experiment loaded");
+        return (EC_ARG);
+    }
+    if (n_exps < 1) {
+        snprintf(z->err, ZC_ERRLEN, "%d experiments", n_exps);
+        return (EC_ARG);
+    }
+
+    m = &(z->m);
+    market_init(m, seed, 0);
+    m->zp = z->zp;
+    m->figs = 0;
+    m->indep = 1;
+
+    strcpy(res->id, m->ec.id);
+    res->n_exps = n_exps;
+    res->n_days = m->ec.n_days;
+    res->max_trades = m->ec.max_trades;
+    res->strat_mask = m->ec.strat_mask;
+    for (d = 0; d < MAX_N_DAYS; d++) ddat_init(res->day + d);
+    for (t = 0; t < MAX_TRADES; t++) {
+        res->trade[t].n = 0;
+        res->trade[t].sum = res->trade[t].sumsq = 0.0;
+    }
+
+    /*the engine draws from this thread's generator and learning parameters: lend it the context's*/
+    caller = *rng_get();
+    caller_zp = zip_get_params();
+    *rng_get() = z->rng;
+    for (e = 0; e < n_exps; e++) {
+        market_exp(m, e, n_exps, &(z->r));
+        exp_add(&(z->r), res->day, res->trade);
+    }
+    z->rng = *rng_get();
+    *rng_get() = caller;
+    zip_set_params(caller_zp);
+    crn_stop();
+    return (EC_OK);
+}
+
+// zip-ctx-error: what went wrong with the last call that failed
+const char *zip_ctx_error(Zip_ctx *z) {
+    return (z == NULL ? "no context" : z->err);
+}
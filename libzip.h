@@ -0,0 +1,47 @@
+//
+// libzip.h: the market as a library, for programs that run experiments many times over (build: make libzip.a)
+//
+// A Zip_ctx holds everything a run changes: its experiment, its market and traders, its learning parameters
+// and its random number generator. Contexts share nothing, so any number can be used one after another, or at
+// once on different threads. Nothing here prints or exits: each function returns EC_OK or one of the EC_ codes
+// of expctl.h, and zip_ctx_error() says what went wrong.
+//
+//   Zip_ctx *z = zip_ctx_new();
+//   static Zip_results res;
+//   if (zip_ctx_load(z, text, strlen(text)) != EC_OK) fprintf(stderr, "%s\n", zip_ctx_error(z));
+//   else if (zip_ctx_run(z, 100, 999, &res) == EC_OK) ... res.day[d].effic.sum / res.day[d].effic.n ...
+//   zip_ctx_free(z);
+//
+// zip_ctx_run(z, n, seed, ...) runs the experiments that "smith -e n" would with that seed, and its results are
+// what smith's graphs are drawn from.
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "ddat.h"
+#include "expctl.h"
+
+// Zip-results: the stats of a run of experiments, each summed over the experiments
+typedef struct a_zip_results {
+    char id[MAX_ID];
+    int n_exps, n_days, max_trades;
+    int strat_mask;                /*bit s set => some agent uses strategy s*/
+    Day_data day[MAX_N_DAYS];      /*each day's efficiency, alpha, price etc.*/
+    Real_stat trade[MAX_TRADES];   /*the rms deviation from equilibrium price of each day's t-th deal*/
+} Zip_results;
+
+typedef struct a_zip_ctx Zip_ctx;
+
+Zip_ctx *zip_ctx_new(void);
+
+void zip_ctx_free(Zip_ctx *);
+
+int zip_ctx_load(Zip_ctx *, const char *, long);
+
+int zip_ctx_load_file(Zip_ctx *, char []);
+
+int zip_ctx_params(Zip_ctx *, Zip_params *);
+
+int zip_ctx_run(Zip_ctx *, int, int, Zip_results *);
+
+const char *zip_ctx_error(Zip_ctx *);
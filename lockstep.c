@@ -0,0 +1,471 @@
+//
+// lockstep.c: run LANES independent experiments side by side, one per SIMD lane
+//
+// The agents' fields are stored [agent][lane], so the learning update, the willingness test and the
+// setting of prices for one agent are done for every lane at once, in loops the compiler turns into
+// vector code. Where the lanes diverge (each has its own shouter, one lane deals while another
+// doesn't, one lane's day has already ended) the choices are made lane by lane and the vector code
+// applies them under a per-lane mask.
+//
+// Random draws stay scalar. Lane l of a group runs experiment e on its own ran1 stream seeded with
+// rs+e, and makes its draws in the same order as the sequential engine does when experiments are
+// independent (smith -e), so the two give identical results.
+//
+// Only ZIP markets with the default learning parameters are handled. The per-trade equilibria and the
+// first experiment's figures, which only feed the single-experiment plots, are not computed.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "sd.h"
+#include "ddat.h"
+#include "expctl.h"
+#include "strategy.h"
+#include "lockstep.h"
+#include "metrics.h"
+
+// Lanes: one side of the market in every lane
+typedef struct lanes {
+    int n;                            /*number of agents trading today*/
+    Cents limit[MAX_AGENTS];          /*limit prices: the same in every lane*/
+    Real t_gain[MAX_AGENTS];          /*theoretical gains: the same in every lane*/
+    Areal profit[MAX_AGENTS][LANES];
+    Areal beta[MAX_AGENTS][LANES];
+    Areal momntm[MAX_AGENTS][LANES];
+    Areal last_d[MAX_AGENTS][LANES];
+    Cents price[MAX_AGENTS][LANES];
+    Real quant[MAX_AGENTS][LANES];
+    Real a_gain[MAX_AGENTS][LANES];
+    int active[MAX_AGENTS][LANES];
+} Lanes;
+
+// Lane-stat: the running stats of one day in every lane, as kept by main() for one experiment
+typedef struct lane_stat {
+    int n_trades[LANES];
+    Real surplus[LANES], sigmasum[LANES], sum_price[LANES], sum_price_diff[LANES];
+    Real price[LANES], last_price[LANES], alpha[LANES], efficiency[LANES];
+    Real ats[MAX_TRADES][LANES];
+    int ats_n[MAX_TRADES][LANES];
+} Lane_stat;
+
+static Lanes ls_buyers, ls_sellers;
+static Lane_stat ls_stat;
+static Ran1 ls_rng[LANES];
+
+// ls-agent-init: initialise one side's agents in one lane, drawing as buy_init()/sell_init() do
+static void ls_agent_init(Lanes *side, int job, int l) {
+    int a;
+    Ran1 *g = ls_rng + l;
+    Zip_params *zp = &zip_defaults;
+
+    for (a = 0; a < MAX_AGENTS; a++) {
+        if (job == BUY) side->profit[a][l] = -1.0 * (zp->profit_min + randval_r(g, zp->profit_range));
+        else side->profit[a][l] = zp->profit_min + randval_r(g, zp->profit_range);
+        side->beta[a][l] = zp->beta_min + randval_r(g, zp->beta_range);
+        side->last_d[a][l] = 0.0;
+        side->momntm[a][l] = 0.2 + randval_r(g, 0.6);
+        side->momntm[a][l] = randval_r(g, zp->mom_range);
+        side->active[a][l] = 1;
+    }
+}
+
+// ls-day-init: load a schedule into one side of every lane
+static void ls_day_init(Lanes *side, SD_sched *sched) {
+    int a, l;
+
+    side->n = sched->n_agents;
+    for (a = 0; a < side->n; a++) {
+        side->limit[a] = sched->agents[a].limit[0];
+        for (l = 0; l < LANES; l++) {
+            side->quant[a][l] = sched->agents[a].n_units;
+            side->active[a][l] = 1;
+            side->a_gain[a][l] = 0.0;
+            side->price[a][l] = CENTS(PRICE(side->limit[a]) * (1 + side->profit[a][l])); /*as set_price()*/
+        }
+    }
+}
+
+// ls-theory: the theoretical equilibrium, which depends only on the schedules and so is shared by all lanes
+static void ls_theory(int max_trades, Real *p_0, Real *max_surplus) {
+    static Agent s[MAX_AGENTS], b[MAX_AGENTS];
+    int a, q_0;
+    Real eq_profit;
+
+    for (a = 0; a < ls_sellers.n; a++) {
+        s[a].job = SELL;
+        s[a].active = 1;
+        s[a].quant = ls_sellers.quant[a][0];
+        s[a].limit = s[a].price = ls_sellers.limit[a];
+    }
+    for (a = 0; a < ls_buyers.n; a++) {
+        b[a].job = BUY;
+        b[a].active = 1;
+        b[a].quant = ls_buyers.quant[a][0];
+        b[a].limit = b[a].price = ls_buyers.limit[a];
+    }
+    supdem(ls_sellers.n, s, ls_buyers.n, b, max_trades, p_0, &q_0, max_surplus, EQ_THEORY, "\0", NULL, 0);
+
+    for (a = 0; a < ls_buyers.n; a++) {
+        eq_profit = ls_buyers.quant[a][0] * (PRICE(ls_buyers.limit[a]) - (*p_0));
+        if (eq_profit < 0.0) eq_profit = 0.0;
+        ls_buyers.t_gain[a] = eq_profit;
+    }
+    for (a = 0; a < ls_sellers.n; a++) {
+        eq_profit = ls_sellers.quant[a][0] * ((*p_0) - PRICE(ls_sellers.limit[a]));
+        if (eq_profit < 0.0) eq_profit = 0.0;
+        ls_sellers.t_gain[a] = eq_profit;
+    }
+}
+
+// ls-update: the ZIP learning update of one side in every lane that shouted (mask), as zip_update()
+static void ls_update(Lanes *side, int job, int mask[], int dt[], int status[], Cents price[]) {
+    int a, l, up[LANES], down[LANES], move[LANES];
+    Cents p;
+    Real r1[LANES], r2[LANES], shout[LANES], target, limit, old;
+    Areal diff, change, newprofit;
+
+    for (l = 0; l < LANES; l++) shout[l] = PRICE(price[l]);
+
+    for (a = 0; a < side->n; a++) {
+        /*which lanes move this agent's margin, and which way (vector)*/
+        for (l = 0; l < LANES; l++) {
+            /*a deal moves every agent that could have taken it; otherwise only active agents move*/
+            if (job == SELL) {
+                up[l] = (status[l] == DEAL) && (side->price[a][l] <= price[l]);
+                down[l] = side->active[a][l] &&
+                          (((status[l] == DEAL) && (side->price[a][l] > price[l]) && (dt[l] == BID)) ||
+                           ((status[l] != DEAL) && (dt[l] == OFFER) && (side->price[a][l] >= price[l])));
+            } else {
+                down[l] = (status[l] == DEAL) && (side->price[a][l] >= price[l]);
+                up[l] = side->active[a][l] &&
+                        (((status[l] == DEAL) && (side->price[a][l] < price[l]) && (dt[l] == OFFER)) ||
+                         ((status[l] != DEAL) && (dt[l] == BID) && (side->price[a][l] <= price[l])));
+            }
+            move[l] = mask[l] && (up[l] || down[l]);
+        }
+
+        /*draw the perturbations of the target prices (scalar: each lane has its own stream)*/
+        for (l = 0; l < LANES; l++) {
+            r1[l] = r2[l] = 0.0;
+            if (move[l]) {
+                r1[l] = randval_r(ls_rng + l, zip_defaults.mark);
+                r2[l] = randval_r(ls_rng + l, zip_defaults.mark_abs);
+            }
+        }
+
+        /*Widrow-Hoff update of the profit margin, as profit_alter() (vector, masked)*/
+        limit = PRICE(side->limit[a]);
+        for (l = 0; l < LANES; l++) {
+            if (up[l]) target = (shout[l] * (1.0 + r1[l])) + r2[l];
+            else target = (shout[l] * (1.0 - r1[l])) - r2[l];
+            old = PRICE(side->price[a][l]);
+            diff = (target - old);
+            change = (((Areal) 1.0 - side->momntm[a][l]) * side->beta[a][l] * diff) +
+                     (side->momntm[a][l] * side->last_d[a][l]);
+            newprofit = ((((Areal) old) + change) / ((Areal) limit)) - (Areal) 1.0;
+            if (job == SELL) { if (!(newprofit > 0.0)) newprofit = side->profit[a][l]; }
+            else { if (!(newprofit < 0.0)) newprofit = side->profit[a][l]; }
+            p = CENTS(limit * (1 + newprofit));
+
+            side->last_d[a][l] = move[l] ? change : side->last_d[a][l];
+            side->profit[a][l] = move[l] ? newprofit : side->profit[a][l];
+            side->price[a][l] = move[l] ? p : side->price[a][l];
+        }
+    }
+}
+
+// ls-willing: form the list of agents in lane l willing to take a shout at price, as get_willing()
+static int ls_willing(Lanes *side, int job, int l, Cents price, int ilist[]) {
+    int a, n = 0;
+
+    for (a = 0; a < side->n; a++) {
+        if (side->active[a][l] && ((job == BUY) ? (side->price[a][l] >= price) : (side->price[a][l] <= price)))
+            ilist[n++] = a;
+    }
+    return (n);
+}
+
+// ls-able: form the list of agents in lane l able to shout, applying the NYSE rules if first==0
+static int ls_able(Lanes *side, int job, int l, int nyse, int first, Cents best, int ilist[]) {
+    int a, n = 0;
+
+    for (a = 0; a < side->n; a++) {
+        if (!side->active[a][l]) continue;
+        if (nyse && (!first)) {
+            if ((job == SELL) && (side->price[a][l] >= best)) continue;
+            if ((job == BUY) && (side->price[a][l] <= best)) continue;
+        }
+        ilist[n++] = a;
+    }
+    return (n);
+}
+
+// ls-bank: settle a deal in lane l, as bank()
+static void ls_bank(int s, int b, int l, Cents price) {
+    Real r;
+
+    r = PRICE(price) - PRICE(ls_sellers.limit[s]);
+    if (r < 0.0) r = 0.0;
+    ls_sellers.a_gain[s][l] += r;
+    ls_stat.surplus[l] += r;
+    ls_sellers.quant[s][l]--;
+    if (ls_sellers.quant[s][l] < 1) ls_sellers.active[s][l] = 0;
+
+    r = PRICE(ls_buyers.limit[b]) - PRICE(price);
+    if (r < 0.0) r = 0.0;
+    ls_buyers.a_gain[b][l] += r;
+    ls_stat.surplus[l] += r;
+    ls_buyers.quant[b][l]--;
+    if (ls_buyers.quant[b][l] < 1) ls_buyers.active[b][l] = 0;
+}
+
+// ls-trade: one trade() in every lane in[]; returns each lane's status and deal price
+static void ls_trade(Expctl *ec, int nyse, int in[], int stat[], Cents deal[]) {
+    int l, a, any, n_able, n_willing, active_b, active_s, traders,
+            go[LANES], dt[LANES], status[LANES], n_fails[LANES], first_offer[LANES], first_bid[LANES],
+            s[LANES], b[LANES], ilist[MAX_AGENTS];
+    int sell_shout, buy_shout, n_shouts = 0, n_deals = 0;
+    Cents price[LANES], best_offer[LANES], best_bid[LANES];
+
+    sell_shout = ec->sup_sched[ec->s_sched].can_shout;
+    buy_shout = ec->dem_sched[ec->d_sched].can_shout;
+
+    for (l = 0; l < LANES; l++) {
+        n_fails[l] = 0;
+        status[l] = NO_DEAL;
+        first_offer[l] = first_bid[l] = 1;
+        price[l] = best_offer[l] = best_bid[l] = 0;
+        dt[l] = OFFER;
+    }
+
+    for (;;) {
+        any = 0;
+        for (l = 0; l < LANES; l++) {
+            go[l] = in[l] && (status[l] == NO_DEAL) && (n_fails[l] < MAX_FAILS);
+            any |= go[l];
+        }
+        if (!any) break;
+
+        for (l = 0; l < LANES; l++) { /*each lane picks its shouter and finds who will take the shout*/
+            if (!go[l]) continue;
+
+            active_b = active_s = 0;
+            for (a = 0; a < ls_buyers.n; a++) active_b += ls_buyers.active[a][l];
+            for (a = 0; a < ls_sellers.n; a++) active_s += ls_sellers.active[a][l];
+            traders = 0;
+            if (sell_shout) traders += active_s;
+            if (buy_shout) traders += active_b;
+
+            if (irand_r(ls_rng + l, traders) < active_s) { /*a seller makes an offer*/
+                dt[l] = OFFER;
+                n_able = ls_able(&ls_sellers, SELL, l, nyse, first_offer[l], best_offer[l], ilist);
+                if (n_able > 0) {
+                    s[l] = ilist[irand_r(ls_rng + l, n_able)];
+                    price[l] = ls_sellers.price[s[l]][l];
+                    if (nyse) {
+                        if (first_offer[l]) {
+                            best_offer[l] = price[l];
+                            first_offer[l] = 0;
+                        } else { if (price[l] < best_offer[l]) best_offer[l] = price[l]; }
+                    }
+                    n_willing = ls_willing(&ls_buyers, BUY, l, price[l], ilist);
+                    if (n_willing > 0) {
+                        status[l] = DEAL;
+                        b[l] = ilist[irand_r(ls_rng + l, n_willing)];
+                    }
+                } else {
+                    n_fails[l] = MAX_FAILS;
+                    status[l] = END_DAY;
+                }
+            } else { /*a buyer makes a bid*/
+                dt[l] = BID;
+                n_able = ls_able(&ls_buyers, BUY, l, nyse, first_bid[l], best_bid[l], ilist);
+                if (n_able > 0) {
+                    b[l] = ilist[irand_r(ls_rng + l, n_able)];
+                    price[l] = ls_buyers.price[b[l]][l];
+                    if (nyse) {
+                        if (first_bid[l]) {
+                            best_bid[l] = price[l];
+                            first_bid[l] = 0;
+                        } else { if (price[l] > best_bid[l]) best_bid[l] = price[l]; }
+                    }
+                    n_willing = ls_willing(&ls_sellers, SELL, l, price[l], ilist);
+                    if (n_willing > 0) {
+                        status[l] = DEAL;
+                        s[l] = ilist[irand_r(ls_rng + l, n_willing)];
+                    }
+                } else {
+                    n_fails[l] = MAX_FAILS;
+                    status[l] = END_DAY;
+                }
+            }
+        }
+
+        /*every lane that shouted updates its traders, then settles any deal*/
+        ls_update(&ls_sellers, SELL, go, dt, status, price);
+        ls_update(&ls_buyers, BUY, go, dt, status, price);
+        for (l = 0; l < LANES; l++) {
+            if (!go[l]) continue;
+            n_shouts++;
+            if (status[l] == DEAL) {
+                ls_bank(s[l], b[l], l, price[l]);
+                n_deals++;
+            } else n_fails[l]++;
+        }
+    }
+    MT_SHOUTS(n_shouts, n_deals);
+
+    for (l = 0; l < LANES; l++) {
+        stat[l] = status[l];
+        deal[l] = price[l];
+    }
+}
+
+// ls-next-sched: move the schedule cursors on to the day's schedules, as day_init() does
+static void ls_next_sched(Expctl *ec, int d) {
+    if (d == 0) ec->d_sched = 0;
+    else if ((d - 1) == ec->dem_sched[ec->d_sched].last_day) {
+        (ec->d_sched)++;
+        if (ec->d_sched == ec->n_dem_sched) {
+            fprintf(stderr, "\nFail: ran out of demand schedules on day %d\n", d);
+            exit(0);
+        }
+    }
+    if (d == 0) ec->s_sched = 0;
+    else if ((d - 1) == ec->sup_sched[ec->s_sched].last_day) {
+        (ec->s_sched)++;
+        if (ec->s_sched == ec->n_sup_sched) {
+            fprintf(stderr, "\nFail: ran out of supply schedules on day %d\n", d);
+            exit(0);
+        }
+    }
+}
+
+// ls-day-end: add one lane's day to the daily data, as main() does at the end of a day
+static void ls_day_end(Day_data *dd, int l) {
+    static Agent s[MAX_AGENTS], b[MAX_AGENTS];
+    int a;
+    Real pd, diff, pdisp;
+
+    pd = 0.0;
+    for (a = 0; a < ls_buyers.n; a++) {
+        diff = (ls_buyers.a_gain[a][l] - ls_buyers.t_gain[a]);
+        pd += (diff * diff);
+    }
+    for (a = 0; a < ls_sellers.n; a++) {
+        diff = (ls_sellers.a_gain[a][l] - ls_sellers.t_gain[a]);
+        pd += (diff * diff);
+    }
+    pdisp = sqrt((1 / ((Real) (ls_buyers.n + ls_sellers.n))) * pd);
+
+    ddat_update(dd, ls_stat.n_trades[l], ls_stat.sum_price[l], ls_stat.alpha[l], pdisp,
+                ls_stat.efficiency[l], ls_stat.sum_price_diff[l]);
+    MT_DAY_END(ls_stat.efficiency[l], ls_stat.alpha[l]);
+
+    for (a = 0; a < ls_sellers.n; a++) {
+        s[a].strat = ST_ZIP;
+        s[a].a_gain = ls_sellers.a_gain[a][l];
+        s[a].t_gain = ls_sellers.t_gain[a];
+    }
+    for (a = 0; a < ls_buyers.n; a++) {
+        b[a].strat = ST_ZIP;
+        b[a].a_gain = ls_buyers.a_gain[a][l];
+        b[a].t_gain = ls_buyers.t_gain[a];
+    }
+    ddat_strat_update(dd, s, ls_sellers.n, b, ls_buyers.n);
+}
+
+// lockstep-run: run n_exps independent ZIP experiments LANES at a time, seeding experiment e with rs+e,
+// and add their results to ddat[] and ats_e[]
+void lockstep_run(Expctl *ec, int n_exps, int rs, Day_data ddat[], Real_stat ats_e[], int verbose) {
+    int e0, l, d, t, any, on[LANES], in[LANES], status[LANES];
+    Cents deal[LANES];
+    Real p_0, max_surplus, pds, alphatrans, price;
+
+    if (ec->strat_mask != (1 << ST_ZIP)) {
+        fprintf(stderr, "\nFail: the lock-step engine only runs ZIP markets\n");
+        exit(0);
+    }
+    if ((ec->nyse != RULES_PLAIN) && (ec->nyse != RULES_NYSE)) {
+        fprintf(stderr, "\nFail: the lock-step engine only runs continuous markets without an order book\n");
+        exit(0);
+    }
+
+    for (e0 = 0; e0 < n_exps; e0 += LANES) {
+        for (l = 0; l < LANES; l++) {
+            on[l] = (e0 + l < n_exps);
+            rseed_r(ls_rng + l, rs + e0 + l);
+            ls_agent_init(&ls_buyers, BUY, l);
+            ls_agent_init(&ls_sellers, SELL, l);
+            ls_stat.price[l] = 0.0;
+            ls_stat.alpha[l] = ls_stat.efficiency[l] = 0.0;
+            for (t = 0; t < MAX_TRADES; t++) {
+                ls_stat.ats[t][l] = 0.0;
+                ls_stat.ats_n[t][l] = 0;
+            }
+        }
+
+        for (d = 0; d < ec->n_days; d++) {
+            MT_DAY(d);
+            ls_next_sched(ec, d);
+            ls_day_init(&ls_buyers, ec->dem_sched + ec->d_sched);
+            ls_day_init(&ls_sellers, ec->sup_sched + ec->s_sched);
+            ls_theory(ec->max_trades, &p_0, &max_surplus);
+
+            for (l = 0; l < LANES; l++) {
+                in[l] = on[l];
+                ls_stat.surplus[l] = 0.0;
+                ls_stat.n_trades[l] = 0;
+                ls_stat.sigmasum[l] = 0.0;
+                ls_stat.sum_price[l] = 0.0;
+                ls_stat.sum_price_diff[l] = 0.0;
+            }
+
+            for (t = 0; t < ec->max_trades; t++) {
+                ls_trade(ec, ec->nyse, in, status, deal);
+
+                any = 0;
+                for (l = 0; l < LANES; l++) { /*calculate stats*/
+                    if (!in[l]) continue;
+                    if (status[l] == DEAL) {
+                        if (t > 0) ls_stat.last_price[l] = ls_stat.price[l];
+                        price = ls_stat.price[l] = PRICE(deal[l]);
+                        if (t > 0)
+                            ls_stat.sum_price_diff[l] += ((price - ls_stat.last_price[l]) *
+                                                          (price - ls_stat.last_price[l]));
+                        pds = ((price - p_0) * (price - p_0));
+                        ls_stat.ats[ls_stat.n_trades[l]][l] += pds;
+                        (ls_stat.ats_n[ls_stat.n_trades[l]][l])++;
+                        (ls_stat.n_trades[l])++;
+                        ls_stat.sum_price[l] += price;
+                        ls_stat.sigmasum[l] += pds;
+                        ls_stat.alpha[l] = (100 * sqrt(ls_stat.sigmasum[l] / ls_stat.n_trades[l])) / p_0;
+                        ls_stat.efficiency[l] = (ls_stat.surplus[l] / max_surplus) * 100;
+                    } else if (status[l] == END_DAY) in[l] = 0; /*give up*/
+                    any |= in[l];
+                }
+                if (!any) break;
+            }
+
+            for (l = 0; l < LANES; l++) { if (on[l]) ls_day_end(ddat + d, l); }
+        }
+
+        for (l = 0; l < LANES; l++) {
+            if (!on[l]) continue;
+            for (t = 0; t < ec->max_trades; t++) {
+                if (ls_stat.ats_n[t][l] > 0) {
+                    alphatrans = sqrt(ls_stat.ats[t][l] / ls_stat.ats_n[t][l]);
+                    (ats_e[t].sum) += alphatrans;
+                    (ats_e[t].sumsq) += (alphatrans * alphatrans);
+                    (ats_e[t].n)++;
+                }
+            }
+            fprintf(stdout, "experiment %d done\n", e0 + l);
+            MT_EXP();
+        }
+    }
+}
@@ -0,0 +1,9 @@
+//
+// lockstep.h: run independent experiments side by side, one per SIMD lane
+//
+
+#ifndef LANES
+#define LANES 4 /*experiments run side by side: the SIMD width for doubles*/
+#endif
+
+void lockstep_run(Expctl *, int, int, Day_data [], Real_stat [], int);
@@ -0,0 +1,1127 @@
+//
+// market.c: the trading engine (see market.h)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include   "max.h"
+#include   "random.h"
+#include   "agent.h"
+#include   "sd.h"
+#include   "ddat.h"
+#include   "tdat.h"
+#include   "expctl.h"
+#include   "prof.h"
+#include   "trace.h"
+#include   "strategy.h"
+#include   "pool.h"
+#include   "book.h"
+#include   "market.h"
+#include   "cache.h"
+#include   "warm.h"
+#include   "metrics.h"
+
+// The trading core is written once, as an always-inlined function taking the NYSE flag as an argument,
+// and instantiated below with that argument constant, so the compiler folds the flag tests out of the
+// shout loop; trade_select() picks the instantiation for an experiment at start-up. What the traders
+// do is looked up in their strategy's table once per partition of the schedule (see strategy.h).
+
+// get-willing: form a list of agents willing to deal
+int get_willing(int job, Cents price, Agent agents[], SD_sched *sched, int ilist[], char *s,
+                int verbose) {
+    int willing = 0, p;
+    Partition *pt;
+
+    for (p = 0; p < sched->n_part; p++) {
+        pt = sched->part + p;
+        willing = strategies[pt->strategy].willing(job, price, agents + pt->first, pt->n, pt->first,
+                                                   ilist, willing, s, verbose);
+    }
+    if (verbose) fprintf(stdout, "%d traders willing to deal\n", willing);
+
+    return (willing);
+}
+
+// nyse-bar: under NYSE rules, mark agents who can't improve on the best shout so far as unable
+void nyse_bar(int job, Agent agents[], SD_sched *sched, Cents best) {
+    int p;
+    Partition *pt;
+
+    for (p = 0; p < sched->n_part; p++) {
+        pt = sched->part + p;
+        strategies[pt->strategy].nyse_bar(job, agents + pt->first, pt->n, best);
+    }
+}
+
+// update-all: update the strategies of all the agents on one side of the market after a shout
+void update_all(int job, int dt, int status, Agent agents[], SD_sched *sched, Cents price, int verbose) {
+    int p;
+    Partition *pt;
+
+    for (p = 0; p < sched->n_part; p++) {
+        pt = sched->part + p;
+        strategies[pt->strategy].update(job, dt, status, agents + pt->first, pt->n, pt->first, price,
+                                        verbose);
+    }
+}
+
+// Update-job: the learning update after one shout, shared out over the thread pool. Items [0, n_sell)
+// are the sellers and the rest are the buyers; each side sees its own deal type and price, indexed by
+// SELL or BUY.
+typedef struct update_job {
+    int dt[2], status, n_sell, verbose;
+    Agent *sellers, *buyers;
+    SD_sched *sup, *dem;
+    Cents price[2];
+    Shout_key *key;
+    Zip_params *zp;
+} Update_job;
+
+// update-part: update agents [first, first+n) of one side of the market, strategy by strategy
+void update_part(int job, Update_job *u, Agent agents[], SD_sched *sched, int first, int n) {
+    int p, lo, hi;
+    Partition *pt;
+
+    for (p = 0; p < sched->n_part; p++) {
+        pt = sched->part + p;
+        lo = (pt->first > first ? pt->first : first);
+        hi = (pt->first + pt->n < first + n ? pt->first + pt->n : first + n);
+        if (lo < hi)
+            strategies[pt->strategy].update(job, u->dt[job], u->status, agents + lo, hi - lo, lo,
+                                            u->price[job], u->verbose);
+    }
+}
+
+// update-range: update items [first, first+n) of an update job, drawing from the agents' keyed streams
+void update_range(void *arg, int first, int n) {
+    Update_job *u = arg;
+    int lo;
+
+    zip_keyed(u->key);
+    zip_set_params(u->zp);
+    if (first < u->n_sell)
+        update_part(SELL, u, u->sellers, u->sup, first, (first + n < u->n_sell ? n : u->n_sell - first));
+    if (first + n > u->n_sell) {
+        lo = (first > u->n_sell ? first : u->n_sell);
+        update_part(BUY, u, u->buyers, u->dem, lo - u->n_sell, first + n - lo);
+    }
+    zip_keyed(NULL);
+}
+
+// update-sides: update the strategies of sellers and then buyers, each side seeing a shout of its own
+// deal type and price. With keyed streams every agent's update is independent of every other's, so it
+// is shared out over the thread pool and gives the same result whatever the number of threads.
+static void update_sides(Expctl *ec, int dt_s, int dt_b, int status, Agent sellers[], Agent buyers[],
+                         Cents price_s, Cents price_b, int verbose) {
+    Update_job u;
+    SD_sched *dem, *sup;
+
+    dem = ec->dem_sched + ec->d_sched;
+    sup = ec->sup_sched + ec->s_sched;
+    if (!ec->keyed) {
+        update_all(SELL, dt_s, status, sellers, sup, price_s, verbose);
+        update_all(BUY, dt_b, status, buyers, dem, price_b, verbose);
+        return;
+    }
+
+    (ec->key.shout)++;
+    u.dt[SELL] = dt_s;
+    u.dt[BUY] = dt_b;
+    u.status = status;
+    u.n_sell = sup->n_agents;
+    u.verbose = (pool_size() == 1 ? verbose : 0); /*traces from several threads would be interleaved*/
+    u.sellers = sellers;
+    u.buyers = buyers;
+    u.sup = sup;
+    u.dem = dem;
+    u.price[SELL] = price_s;
+    u.price[BUY] = price_b;
+    u.key = &(ec->key);
+    u.zp = zip_get_params();
+    pool_run(update_range, &u, sup->n_agents + dem->n_agents);
+}
+
+// update-shout: update the strategies of sellers and then buyers after a shout
+void update_shout(Expctl *ec, int dt, int status, Agent sellers[], Agent buyers[], Cents price, int verbose) {
+    update_sides(ec, dt, dt, status, sellers, buyers, price, price, verbose);
+}
+
+// get-able: form a list of agents able to deal
+int get_able(Cents price, Agent agents[], int n, int ilist[], char *s, int verbose) {
+    int able = 0, a;
+
+    for (a = 0; a < n; a++) {
+        if (agents[a].able) {
+            ilist[able] = a;
+            able++;
+            if (verbose) {
+                fprintf(stdout, "%s%2d able (reward=%5.3f)\n",
+                        s, a, reward(agents + a, price));
+            }
+        }
+    }
+    return (able);
+}
+
+// bank: adjust bank balances of buyer and seller in a deal
+void bank(Agent *s, Agent *b, Cents price, Real *surplus, int verbose) {
+    Real r;
+
+    /*seller*/
+    r = reward(s, price);
+    (s->bank) += r;
+    (s->a_gain) += r;
+    (*surplus) += (r);
+
+    (s->quant)--;
+    if (s->quant < 1) s->active = 0;
+    if (verbose) {
+        fprintf(stdout, "Seller: limit=%f reward=%f bank=%f quant=%d (surp=%f)\n",
+                PRICE(s->limit), r, s->bank, s->quant, *surplus);
+    }
+
+    /*buyer*/
+    r = reward(b, price);
+    (b->bank) += r;
+    (b->a_gain) += r;
+    (*surplus) += (r);
+
+    (b->quant)--;
+    if (b->quant < 1) b->active = 0;
+    if (verbose) {
+        fprintf(stdout, "Buyer: limit=%f reward=%f bank=%f quant=%d (surp=%f)\n",
+                PRICE(b->limit), r, b->bank, b->quant, *surplus);
+    }
+}
+
+
+// day-init: initialise all data structures for start of day, drawing the theoretical supply and
+// demand curves if fig is set
+void day_init(int fig, int day_number, Expctl *ec,
+              Agent sellers[], Agent buyers[],
+              Real *p_0, Real *max_surplus, int verbose) {
+    int b, s, q_0, s_sched, d_sched, n_buy, n_sell;
+    Real eq_profit;
+    char filename[40];
+
+    /*initialise the buyers*/
+    if (day_number == 0) { /* first day: read the first demand schedule*/
+        ec->d_sched = 0;
+    } else if ((day_number - 1) ==
+               (ec->dem_sched[ec->d_sched].last_day)) { /*previous day was last day on that demand schedule: update*/
+        (ec->d_sched)++;
+        if (ec->d_sched == ec->n_dem_sched) {
+            fprintf(stderr, "\nFail: ran out of demand schedules on day %d\n",
+                    day_number);
+            exit(0);
+        }
+    }
+    d_sched = ec->d_sched;
+    n_buy = ec->dem_sched[d_sched].n_agents;
+
+    /*mark all buyers active, set quantities and limit prices*/
+    for (b = 0; b < n_buy; b++) {
+        buyers[b].quant = ec->dem_sched[d_sched].agents[b].n_units;
+        buyers[b].active = 1;
+        buyers[b].a_gain = 0.0;
+        /*NOTE: ONLY ALLOWS FOR ONE LIMIT PRICE*/
+        buyers[b].limit = ec->dem_sched[d_sched].agents[b].limit[0];
+        buyers[b].strat = ec->dem_sched[d_sched].agents[b].strategy;
+        set_price(buyers + b);
+        if (verbose) fprintf(stdout, "buyer %d price %f\n", b, PRICE(buyers[b].price));
+    }
+
+    /*initialise the sellers*/
+    if (day_number == 0) { /* first day: read the first demand schedule*/
+        ec->s_sched = 0;
+    } else if ((day_number - 1) ==
+               (ec->sup_sched[ec->s_sched].last_day)) { /*previous day was last day on that supply schedule: update*/
+        (ec->s_sched)++;
+        if (ec->s_sched == ec->n_sup_sched) {
+            fprintf(stderr, "\nFail: ran out of supply schedules on day %d\n",
+                    day_number);
+            exit(0);
+        }
+    }
+    s_sched = ec->s_sched;
+    n_sell = ec->sup_sched[s_sched].n_agents;
+
+    /*mark all sellers active, set quantities and limit prices*/
+    for (s = 0; s < n_sell; s++) {
+        sellers[s].quant = ec->sup_sched[s_sched].agents[s].n_units;
+        sellers[s].active = 1;
+        sellers[s].a_gain = 0.0;
+        /*NOTE: ONLY ALLOWS FOR ONE LIMIT PRICE*/
+        sellers[s].limit = ec->sup_sched[s_sched].agents[s].limit[0];
+        sellers[s].strat = ec->sup_sched[s_sched].agents[s].strategy;
+        set_price(sellers + s);
+        if (verbose) fprintf(stdout, "seller %d price %f\n", s, PRICE(sellers[s].price));
+    }
+
+    /* find theoretical equilibrium price*/
+    if (fig) sprintf(filename, "%ssd%02d_000.fig", ec->id, day_number + 1);
+    else sprintf(filename, "\0");
+    supdem(n_sell, sellers, n_buy, buyers,
+           ec->max_trades, p_0, &q_0, max_surplus, EQ_THEORY, filename,
+           NULL, verbose);
+
+    /*set theoretical gains for buyers and sellers*/
+    for (b = 0; b < n_buy; b++) {
+        eq_profit = buyers[b].quant * (PRICE(buyers[b].limit) - (*p_0));
+        if (eq_profit < 0.0) eq_profit = 0.0;
+        buyers[b].t_gain = eq_profit;
+    }
+    for (s = 0; s < n_sell; s++) {
+        eq_profit = sellers[s].quant * ((*p_0) - PRICE(sellers[s].limit));
+        if (eq_profit < 0.0) eq_profit = 0.0;
+        sellers[s].t_gain = eq_profit;
+    }
+}
+
+// trade-core: see if a buyer and a seller can be found who will enter into a trade
+ALWAYS_INLINE void trade_core(Trade_data *tdat, Agent sellers[], Agent buyers[], Expctl *ec,
+                              Real max_surplus, Real *surplus, int *stat, int verbose,
+                              const int nyse) {
+    int b, s,        /*buyer and seller indices*/
+    dt,         /*deal type*/
+    status,     /*what's happening*/
+    eq_q,       /*equilibrium quantity*/
+    n_willing, /*number of agents willing to trade at a given price*/
+    n_able,     /*number of agents able to trade at a given price*/
+    n_fails,    /*number of failed/declined bids/offers*/
+    n_buy,      /*number of buyers*/
+    n_sell,     /*number of sellers*/
+    active_b,   /*number of active buyers*/
+    active_s,   /*number of active sellers*/
+    sell_shout, /*can sellers shout offers?*/
+    buy_shout, /*can buyers shout bids?*/
+    traders,    /*number of traders to choose from when generating shout*/
+    first_offer,/* ag raised until an opening offer is made*/
+    first_bid, /*falg raised unitl an opening bid is made*/
+    n_shouts,   /*number of bids/offers shouted*/
+    ilist[MAX_AGENTS]; /*list of indices*/
+
+    SD_sched *dem, *sup; /*today's demand and supply schedules*/
+
+    Real eq_p,      /*equilibrium price*/
+    cur_surp; /*current actual max surplus*/
+
+    Cents best_offer,/*used in NYSE rules*/
+    best_bid, /*used in NYSE rules*/
+    price;     /*price of bid/ask*/
+
+    n_buy = ec->dem_sched[ec->d_sched].n_agents;
+    n_sell = ec->sup_sched[ec->s_sched].n_agents;
+    sell_shout = ec->sup_sched[ec->s_sched].can_shout;
+    buy_shout = ec->dem_sched[ec->d_sched].can_shout;
+    dem = ec->dem_sched + ec->d_sched;
+    sup = ec->sup_sched + ec->s_sched;
+
+    if ((sell_shout == 0) && (buy_shout == 0)) {
+        fprintf(stderr, "\nFAIL: Can't have both buyers AND sellers silent\n");
+        exit(0);
+    }
+
+    /* find the theoretical equilibrium price*/
+    PROF_START(PH_THEORY_EQ);
+    supdem(n_sell, sellers, n_buy, buyers, ec->max_trades,
+           &eq_p, &eq_q, &cur_surp, EQ_THEORY,
+           "\0", NULL, verbose);
+    PROF_STOP(PH_THEORY_EQ);
+    PROF_ITEMS(PH_THEORY_EQ, n_sell + n_buy);
+    if (eq_q != NULL_EQ) {
+        tdat->t_eq_p = eq_p;
+        tdat->t_eq_q = eq_q;
+    } else tdat->t_eq_q = NULL_EQ;
+
+    /* find the actual equilibrium price*/
+    PROF_START(PH_ACTUAL_EQ);
+    supdem(n_sell, sellers, n_buy, buyers, ec->max_trades,
+           &eq_p, &eq_q, &cur_surp, EQ_ACTUAL,
+           "\0", NULL, verbose);
+    PROF_STOP(PH_ACTUAL_EQ);
+    PROF_ITEMS(PH_ACTUAL_EQ, n_sell + n_buy);
+    if (eq_q != NULL_EQ) {
+        tdat->a_eq_p = eq_p;
+        tdat->a_eq_q = eq_q;
+    } else tdat->a_eq_q = NULL_EQ;
+
+    n_fails = 0;
+    n_shouts = 0;
+    status = NO_DEAL;
+    first_offer = 1;
+    first_bid = 1;
+    while ((status == NO_DEAL) && (n_fails < MAX_FAILS)) {
+        n_shouts++;
+        crn_shout(ec->key.shout); /*under common random numbers, each shout has its own streams*/
+        PROF_START(PH_SHOUTER);
+        PROF_ITEMS(PH_SHOUTER, n_sell + n_buy);
+        /*count active agents and mark them as able to bid*/
+        active_b = 0;
+        for (b = 0; b < n_buy; b++) {
+            if (buyers[b].active) {
+                buyers[b].able = 1;
+                active_b++;
+            } else buyers[b].able = 0;
+        }
+        active_s = 0;
+        for (s = 0; s < n_sell; s++) {
+            if (sellers[s].active) {
+                sellers[s].able = 1;
+                active_s++;
+            } else sellers[s].able = 0;
+        }
+
+        traders = 0;
+        if (sell_shout) traders += active_s;
+        if (buy_shout) traders += active_b;
+
+        if (verbose)
+            fprintf(stdout, "%d traders: active_s=%d active_b=%d\n",
+                    traders, active_s, active_b);
+
+        if (irand_c(RS_SHOUT, traders) < active_s) { /*is there a seller able to make   an offer?*/
+            dt = OFFER;
+
+            if (nyse && (!first_offer)) nyse_bar(SELL, sellers, sup, best_offer);
+            n_able = get_able(0.0, sellers, n_sell, ilist, "S", verbose);
+
+            if (n_able > 0) { /*an able seller makes an offer*/
+                s = ilist[irand_c(RS_SHOUT, n_able)];
+                /*get price for seller*/
+                price = get_price(sellers + s, s, strategies + sellers[s].strat, verbose);
+                if (nyse) {
+                    if (first_offer) {
+                        best_offer = price;
+                        first_offer = 0;
+                    } else { if (price < best_offer) best_offer = price; }
+                }
+
+                PROF_STOP(PH_SHOUTER);
+
+                /*get willing buyers*/
+                PROF_START(PH_WILLING);
+                n_willing = get_willing(BUY, price, buyers, dem, ilist, "B", verbose);
+                PROF_STOP(PH_WILLING);
+                PROF_ITEMS(PH_WILLING, n_buy);
+                if (n_willing > 0) status = DEAL;
+            } else {
+                PROF_STOP(PH_SHOUTER);
+                if (verbose) fprintf(stdout, "No sellers able to offer\n");
+                n_fails = MAX_FAILS;
+                status = END_DAY;
+            }
+        } else { /*is there a buyer able to make a bid?*/
+            dt = BID;
+            if (nyse && (!first_bid)) nyse_bar(BUY, buyers, dem, best_bid);
+            n_able = get_able(0.0, buyers, n_buy, ilist, "B", verbose);
+
+            if (n_able > 0) { /*an able buyer makes a bid*/
+                b = ilist[irand_c(RS_SHOUT, n_able)];
+
+                /*get price for buyer*/
+                price = get_price(buyers + b, b, strategies + buyers[b].strat, verbose);
+                if (nyse) {
+                    if (first_bid) {
+                        best_bid = price;
+                        first_bid = 0;
+                    } else { if (price > best_bid) best_bid = price; }
+                }
+
+                PROF_STOP(PH_SHOUTER);
+
+                /*get willing selllers*/
+                PROF_START(PH_WILLING);
+                n_willing = get_willing(SELL, price, sellers, sup, ilist, "S", verbose);
+                PROF_STOP(PH_WILLING);
+                PROF_ITEMS(PH_WILLING, n_sell);
+                if (n_willing > 0) status = DEAL;
+            } else {
+                PROF_STOP(PH_SHOUTER);
+                if (verbose) fprintf(stdout, "No buyers able to bid\n");
+                n_fails = MAX_FAILS;
+                status = END_DAY;
+            }
+        }
+
+        if (status == DEAL) { /*DEAL*/
+            if (dt == OFFER) { /*select the willing buyer for this offer*/
+                b = ilist[irand_c(RS_MATCH, n_willing)];
+                if (verbose) {
+                    fprintf(stdout,
+                            "Seller %d sells to Buyer %d (reward=%5.3f)\n",
+                            s, b, reward(buyers + b, price));
+                }
+            } else { /*select the willing seller for this bid*/
+                s = ilist[irand_c(RS_MATCH, n_willing)];
+                if (verbose) {
+                    fprintf(stdout,
+                            "Buyer %d buys from Seller %d (reward=%5.3f)\n",
+                            b, s, reward(sellers + s, price));
+                }
+            }
+
+            /*record what happened*/
+            tdat->deal_p = price;
+            tdat->deal_t = dt;
+
+            /*update trading strategies of buyers and sellers*/
+            PROF_START(PH_UPDATE);
+            update_shout(ec, dt, status, sellers, buyers, price, verbose);
+            PROF_STOP(PH_UPDATE);
+            PROF_ITEMS(PH_UPDATE, n_sell + n_buy);
+
+            /*update bank accounts of buyer and seller*/
+            PROF_START(PH_BANK);
+            bank(sellers + s, buyers + b, price, surplus, verbose);
+            PROF_STOP(PH_BANK);
+        } else { /*NO DEAL or END DAY*/
+            n_fails++;
+            if (verbose) fprintf(stdout, "No willing takers (fails=%d)\n", n_fails);
+            tdat->deal_p = -1; /*negative price => no deal*/
+
+            /*update trading strategies of buyers and sellers*/
+            PROF_START(PH_UPDATE);
+            update_shout(ec, dt, status, sellers, buyers, price, verbose);
+            PROF_STOP(PH_UPDATE);
+            PROF_ITEMS(PH_UPDATE, n_sell + n_buy);
+        }
+    }
+    MT_SHOUTS(n_shouts, status == DEAL);
+    *stat = status;
+}
+
+// trade-plain: no NYSE rules
+void trade_plain(Trade_data *tdat, Agent sellers[], Agent buyers[], Expctl *ec, Standing *st,
+                 Real max_surplus, Real *surplus, int *stat, int verbose) {
+    trade_core(tdat, sellers, buyers, ec, max_surplus, surplus, stat, verbose, 0);
+}
+
+// trade-nyse: NYSE rules
+void trade_nyse(Trade_data *tdat, Agent sellers[], Agent buyers[], Expctl *ec, Standing *st,
+                Real max_surplus, Real *surplus, int *stat, int verbose) {
+    trade_core(tdat, sellers, buyers, ec, max_surplus, surplus, stat, verbose, 1);
+}
+
+// trade-eq: record the theoretical and actual equilibria before a trade, as trade_core() does
+static void trade_eq(Trade_data *tdat, Agent sellers[], Agent buyers[], Expctl *ec, int verbose) {
+    int n_buy, n_sell;
+    Real cur_surp;
+
+    n_buy = ec->dem_sched[ec->d_sched].n_agents;
+    n_sell = ec->sup_sched[ec->s_sched].n_agents;
+    PROF_START(PH_THEORY_EQ);
+    supdem(n_sell, sellers, n_buy, buyers, ec->max_trades, &(tdat->t_eq_p), &(tdat->t_eq_q), &cur_surp,
+           EQ_THEORY, "\0", NULL, verbose);
+    PROF_STOP(PH_THEORY_EQ);
+    PROF_ITEMS(PH_THEORY_EQ, n_sell + n_buy);
+    PROF_START(PH_ACTUAL_EQ);
+    supdem(n_sell, sellers, n_buy, buyers, ec->max_trades, &(tdat->a_eq_p), &(tdat->a_eq_q), &cur_surp,
+           EQ_ACTUAL, "\0", NULL, verbose);
+    PROF_STOP(PH_ACTUAL_EQ);
+    PROF_ITEMS(PH_ACTUAL_EQ, n_sell + n_buy);
+}
+
+// call-quote: have every active trader on one side quote, if the side can shout (a silent side stands on
+// its last quotes); returns the number of active traders
+static int call_quote(Agent agents[], int n, int can_shout, int verbose) {
+    int a, active = 0;
+
+    for (a = 0; a < n; a++) {
+        if (!agents[a].active) continue;
+        if (can_shout) get_price(agents + a, a, strategies + agents[a].strat, verbose);
+        active++;
+    }
+    return (active);
+}
+
+// call-units: list every unit quoted at price or better (at or below it for sellers, at or above it for
+// buyers) by the trader holding it; returns how many
+static int call_units(int job, Agent agents[], int n, Cents price, int units[]) {
+    int a, q, k = 0;
+
+    for (a = 0; a < n; a++) {
+        if (!agents[a].active) continue;
+        if ((job == SELL) ? (agents[a].price > price) : (agents[a].price < price)) continue;
+        for (q = 0; q < agents[a].quant; q++) units[k++] = a;
+    }
+    return (k);
+}
+
+// call-shuffle: put a list of units in random order, so that neither rationing the longer side nor the
+// order the deals are done in favours any trader
+static void call_shuffle(int units[], int n) {
+    int i, j, u;
+
+    for (i = n - 1; i > 0; i--) {
+        j = irand_c(RS_MATCH, i + 1);
+        u = units[i];
+        units[i] = units[j];
+        units[j] = u;
+    }
+}
+
+// call-best: the lowest offer or highest bid quoted on one side
+static Cents call_best(int job, Agent agents[], int n) {
+    int a, first = 1;
+    Cents best = 0;
+
+    for (a = 0; a < n; a++) {
+        if (!agents[a].active) continue;
+        if (first || ((job == SELL) ? (agents[a].price < best) : (agents[a].price > best))) best = agents[a].price;
+        first = 0;
+    }
+    return (best);
+}
+
+// trade-call: call-market rules. Deal the next unit matched at the last auction, holding auctions until
+// one matches some units if none is left. After an auction that matches units every trader learns as
+// from a deal at the clearing price, the sellers as if a bid had made it and the buyers as if an offer
+// had, so that those priced out of it move towards it; after one that matches none, each side learns
+// as if the best quote of its own side had found no taker. The day ends after MAX_FAILS such auctions.
+void trade_call(Trade_data *tdat, Agent sellers[], Agent buyers[], Expctl *ec, Standing *st,
+                Real max_surplus, Real *surplus, int *stat, int verbose) {
+    int s, b, n_buy, n_sell, n_s, n_b, n_fails, active_s, active_b, eq_q;
+    Real eq_p, cur_surp;
+    SD_sched *dem, *sup;
+    Call_book *book = &(st->call);
+
+    n_buy = ec->dem_sched[ec->d_sched].n_agents;
+    n_sell = ec->sup_sched[ec->s_sched].n_agents;
+    dem = ec->dem_sched + ec->d_sched;
+    sup = ec->sup_sched + ec->s_sched;
+    trade_eq(tdat, sellers, buyers, ec, verbose);
+
+    n_fails = 0;
+    if (book->next >= book->n) { /*nothing left from the last auction: hold another*/
+        book->n = book->next = 0;
+        while ((book->n == 0) && (n_fails < MAX_FAILS)) {
+            crn_shout(ec->key.shout); /*under common random numbers, each auction has its own streams*/
+            PROF_START(PH_SHOUTER);
+            active_s = call_quote(sellers, n_sell, sup->can_shout, verbose);
+            active_b = call_quote(buyers, n_buy, dem->can_shout, verbose);
+            PROF_STOP(PH_SHOUTER);
+            PROF_ITEMS(PH_SHOUTER, n_sell + n_buy);
+            if ((active_s == 0) || (active_b == 0)) {
+                if (verbose) fprintf(stdout, "No %s left to trade\n", (active_s == 0 ? "sellers" : "buyers"));
+                break;
+            }
+
+            /*clear the quotes*/
+            PROF_START(PH_WILLING);
+            supdem(n_sell, sellers, n_buy, buyers, ec->max_trades, &eq_p, &eq_q, &cur_surp, EQ_ACTUAL, "\0",
+                   NULL, verbose);
+            n_s = n_b = 0;
+            if (eq_q != NULL_EQ) {
+                book->price = CENTS(eq_p);
+                n_s = call_units(SELL, sellers, n_sell, book->price, book->s);
+                n_b = call_units(BUY, buyers, n_buy, book->price, book->b);
+                book->n = (n_s < n_b ? n_s : n_b);
+            }
+            PROF_STOP(PH_WILLING);
+            PROF_ITEMS(PH_WILLING, n_sell + n_buy);
+
+            PROF_START(PH_UPDATE);
+            if (book->n > 0) {
+                if (verbose)
+                    fprintf(stdout, "Auction clears at %5.2f: %d units offered, %d bid, %d dealt\n",
+                            PRICE(book->price), n_s, n_b, book->n);
+                call_shuffle(book->s, n_s);
+                call_shuffle(book->b, n_b);
+                update_sides(ec, BID, OFFER, DEAL, sellers, buyers, book->price, book->price, verbose);
+            } else {
+                n_fails++;
+                if (verbose) fprintf(stdout, "Auction matches nothing (fails=%d)\n", n_fails);
+                update_sides(ec, OFFER, BID, NO_DEAL, sellers, buyers, call_best(SELL, sellers, n_sell),
+                             call_best(BUY, buyers, n_buy), verbose);
+            }
+            PROF_STOP(PH_UPDATE);
+            PROF_ITEMS(PH_UPDATE, n_sell + n_buy);
+        }
+        if (book->n == 0) {
+            tdat->deal_p = -1; /*negative price => no deal*/
+            MT_SHOUTS(n_fails, 0); /*to the counters, a failed auction is a failed shout*/
+            *stat = END_DAY;
+            return;
+        }
+    }
+
+    s = book->s[book->next];
+    b = book->b[book->next];
+    (book->next)++;
+    if (verbose)
+        fprintf(stdout, "Seller %d sells to Buyer %d at the clearing price %5.2f\n", s, b, PRICE(book->price));
+    tdat->deal_p = book->price;
+    tdat->deal_t = BID; /*neither side shouted it*/
+    PROF_START(PH_BANK);
+    bank(sellers + s, buyers + b, book->price, surplus, verbose);
+    PROF_STOP(PH_BANK);
+    MT_SHOUTS(n_fails + 1, 1); /*and a unit dealt is a shout taken*/
+    *stat = DEAL;
+}
+
+// book-silent: place an order from every active trader on a silent side, at its price, to stand all day
+static void book_silent(Book_side *side, Agent agents[], int n) {
+    int a;
+
+    for (a = 0; a < n; a++) {
+        if (agents[a].active) book_rest(side, a, agents[a].price, (int) agents[a].quant);
+    }
+}
+
+// trade-book: order-book rules. Deal the next unit filled by the last order, if any is left; otherwise
+// take shouts as trade_core() does, each an order replacing its trader's last, until one fills or
+// MAX_FAILS have found no taker. After each shout the traders learn as in the continuous market, from
+// the price of its first fill if it filled. An order priced off the book's grid is refused, which counts
+// as a shout no one took.
+void trade_book(Trade_data *tdat, Agent sellers[], Agent buyers[], Expctl *ec, Standing *st,
+                Real max_surplus, Real *surplus, int *stat, int verbose) {
+    int a, s, b, n, n_buy, n_sell, active_s, active_b, traders, job, n_fails, n_shouts, ilist[MAX_AGENTS];
+    Cents price;
+    Agent *agents;
+    Fill *f;
+    SD_sched *dem, *sup;
+    Order_book *ob = &(st->book);
+
+    n_buy = ec->dem_sched[ec->d_sched].n_agents;
+    n_sell = ec->sup_sched[ec->s_sched].n_agents;
+    dem = ec->dem_sched + ec->d_sched;
+    sup = ec->sup_sched + ec->s_sched;
+    trade_eq(tdat, sellers, buyers, ec, verbose);
+    if (!ob->open) { /*the day's first trade: silent traders never shout, so their orders stand all day*/
+        if (!sup->can_shout) book_silent(&(ob->asks), sellers, n_sell);
+        if (!dem->can_shout) book_silent(&(ob->bids), buyers, n_buy);
+        ob->open = 1;
+    }
+
+    n_fails = n_shouts = 0;
+    while ((ob->next_fill >= ob->n_fills) && (n_fails < MAX_FAILS)) {
+        n_shouts++;
+        crn_shout(ec->key.shout); /*under common random numbers, each shout has its own streams*/
+        PROF_START(PH_SHOUTER);
+        PROF_ITEMS(PH_SHOUTER, n_sell + n_buy);
+        active_b = 0;
+        for (b = 0; b < n_buy; b++) {
+            buyers[b].able = buyers[b].active;
+            active_b += buyers[b].active;
+        }
+        active_s = 0;
+        for (s = 0; s < n_sell; s++) {
+            sellers[s].able = sellers[s].active;
+            active_s += sellers[s].active;
+        }
+        if (!sup->can_shout) active_s = 0;
+        if (!dem->can_shout) active_b = 0;
+        traders = active_s + active_b;
+        if (traders == 0) {
+            PROF_STOP(PH_SHOUTER);
+            if (verbose) fprintf(stdout, "No traders able to shout\n");
+            tdat->deal_p = -1; /*negative price => no deal*/
+            MT_SHOUTS(n_shouts, 0);
+            *stat = END_DAY;
+            return;
+        }
+
+        /*a trader shouts, replacing its order in the book*/
+        job = (irand_c(RS_SHOUT, traders) < active_s ? SELL : BUY);
+        agents = (job == SELL ? sellers : buyers);
+        n = get_able(0, agents, (job == SELL ? n_sell : n_buy), ilist, (job == SELL ? "S" : "B"), verbose);
+        a = ilist[irand_c(RS_SHOUT, n)];
+        price = get_price(agents + a, a, strategies + agents[a].strat, verbose);
+        ob->dt = (job == SELL ? OFFER : BID);
+        PROF_STOP(PH_SHOUTER);
+
+        PROF_START(PH_WILLING);
+        n = book_order(ob, job, a, price, (int) agents[a].quant);
+        PROF_STOP(PH_WILLING);
+        if (verbose)
+            fprintf(stdout, "%s %d orders %d at %5.2f: %d filled, %d bids and %d asks resting\n",
+                    (job == SELL ? "Seller" : "Buyer"), a, (int) agents[a].quant, PRICE(price), (n > 0 ? n : 0),
+                    ob->bids.n, ob->asks.n);
+
+        PROF_START(PH_UPDATE);
+        if (n > 0) update_shout(ec, ob->dt, DEAL, sellers, buyers, ob->fill[0].price, verbose);
+        else {
+            n_fails++;
+            update_shout(ec, ob->dt, NO_DEAL, sellers, buyers, price, verbose);
+        }
+        PROF_STOP(PH_UPDATE);
+        PROF_ITEMS(PH_UPDATE, n_sell + n_buy);
+    }
+    if (ob->next_fill >= ob->n_fills) { /*MAX_FAILS shouts and no taker*/
+        tdat->deal_p = -1;
+        MT_SHOUTS(n_shouts, 0);
+        *stat = NO_DEAL;
+        return;
+    }
+
+    f = ob->fill + (ob->next_fill)++;
+    if (verbose) fprintf(stdout, "Seller %d sells to Buyer %d at %5.2f\n", f->s, f->b, PRICE(f->price));
+    tdat->deal_p = f->price;
+    tdat->deal_t = ob->dt;
+    PROF_START(PH_BANK);
+    bank(sellers + f->s, buyers + f->b, f->price, surplus, verbose);
+    PROF_STOP(PH_BANK);
+    MT_SHOUTS((n_shouts > 0 ? n_shouts : 1), 1); /*a unit left from an earlier order counts as a shout taken*/
+    *stat = DEAL;
+}
+
+// trade-select: choose the specialised trade() for an experiment's rules
+Trade_fn trade_select(Expctl *ec) {
+    if (ec->nyse == RULES_BOOK) return (trade_book);
+    if (ec->nyse == RULES_CALL) return (trade_call);
+    return ((ec->nyse == RULES_NYSE) ? trade_nyse : trade_plain);
+}
+
+
+// market-init: set up a market on the experiment already read into m->ec, with the default learning
+// parameters and nothing carried over yet
+void market_init(Market *m, int rs, int verbose) {
+    int t;
+
+    m->zp = zip_defaults;
+    m->trade = trade_select(&(m->ec));
+    m->verbose = verbose;
+    m->figs = 1;
+    m->indep = 0;
+    m->rs = rs;
+    m->warm = NULL;
+    m->jitter = 0.0;
+    m->warm_day = 0;
+    m->crn = m->anti = 0;
+    m->day_fn = NULL;
+    m->day_arg = NULL;
+    m->ec.keyed = 0;
+    m->price = m->alpha = m->efficiency = 0.0;
+    for (t = 0; t < MAX_TRADES; t++) {
+        m->ats_n[t] = 0;
+        m->ats[t] = 0.0;
+    }
+}
+
+// market-exp: run experiment e (of n_exps) on a market, returning what it adds to the run's results in r
+void market_exp(Market *m, int e, int n_exps, Exp_result *r) {
+    int d,          /*day*/
+    t,              /*transaction number within a day*/
+    status,         /*how things are going*/
+    s, b,           /*seller, buyer, loop indices*/
+    n_buy,          /*number of buyers*/
+    n_sell,         /*number of sellers*/
+    n_trades,       /*number of trades done in a day*/
+    max_trades,     /*maxmimum number of trades in a session*/
+    dummy_i,        /*dummy integer*/
+    verbose = m->verbose;
+    Real price, p_0, sigmasum, alpha, last_price, sum_price_diff,
+            dummy_r1, dummy_r2,
+            sum_price,
+            diff, pd, pdisp, pds,
+            bounddata[4],    /*can be used to inhibit autoscaling on supdem*/
+    *bounds,
+            max_surplus, surplus, efficiency;
+    char fname[60];
+    Expctl *ec = &(m->ec);
+    Agent *buyers = m->buyers, *sellers = m->sellers;
+    Exp_day *xd;
+    Day_data dd[MAX_N_DAYS];         /*the first experiment's own daily data, for its trade graph*/
+    Real_stat ats_0[MAX_TRADES];
+    FILE *fp;
+
+    TRACE_BEGIN("experiment", e);
+    zip_set_params(&(m->zp));
+    ec->key.exp = e;
+    ec->key.shout = 0;
+    ec->key.anti = 0;
+    if (m->crn) { /*every draw from a stream keyed by the experiment, which its antithetic twin mirrors*/
+        if (m->anti) {
+            ec->key.exp = e - (e & 1);
+            ec->key.anti = e & 1;
+        }
+        crn_start(ec->key.exp, ec->key.anti);
+        ec->keyed = 1; /*target prices from the agents' keyed streams, too*/
+    } else crn_stop();
+
+    if (m->indep) { /*start afresh from this experiment's own seed*/
+        rseed_r(rng_get(), m->rs + e);
+        m->price = m->alpha = m->efficiency = 0.0;
+        for (t = 0; t < MAX_TRADES; t++) {
+            m->ats_n[t] = 0;
+            m->ats[t] = 0.0;
+        }
+    }
+    if (cache_get(m, e, r)) { /*this very experiment has been run before*/
+        if (m->day_fn != NULL) {
+            for (d = 0; d < r->n_days; d++) m->day_fn(m->day_arg, e, d, r->day + d);
+        }
+        MT_EXP();
+        TRACE_END("experiment");
+        return;
+    }
+    price = m->price;
+    alpha = m->alpha;
+    efficiency = m->efficiency;
+
+    buy_init(buyers, verbose);
+    sell_init(sellers, verbose);
+    if (m->warm != NULL) warm_apply(m->warm, buyers, sellers, m->jitter);
+
+    r->n_days = ec->n_days;
+    r->max_trades = ec->max_trades;
+    for (d = 0; d < ec->n_days; d++) { /*one trading period or "day"*/
+        TRACE_BEGIN("day", d);
+        MT_DAY(d);
+
+        /*set maximum number of trades in this day*/
+        max_trades = ec->max_trades;
+        if (verbose) fprintf(stdout, "\nday %d: %d trades\n", d + 1, max_trades);
+
+        /*set things up for the start of the day*/
+        PROF_START(PH_DAY_INIT);
+        day_init(m->figs && (e == 0), d, ec, sellers, buyers, &p_0, &max_surplus, verbose);
+        PROF_STOP(PH_DAY_INIT);
+        n_buy = ec->dem_sched[ec->d_sched].n_agents;
+        n_sell = ec->sup_sched[ec->s_sched].n_agents;
+
+        surplus = 0.0;
+        n_trades = 0;
+        /*units matched at an auction yesterday aren't dealt today, and orders don't stand overnight*/
+        m->standing.call.n = m->standing.call.next = 0;
+        if (ec->nyse == RULES_BOOK) book_clear(&(m->standing.book));
+        sigmasum = 0.0;
+        sum_price = 0.0;
+        sum_price_diff = 0.0;
+
+        bounds = NULL;
+
+        bounddata[0] = 1;
+        bounddata[1] = 12;
+        bounddata[2] = 0.0;
+        bounddata[3] = 3.75;
+        bounds = &(bounddata[0]);
+        if (m->figs && (e == 0)) /* first experiment?*/
+        { /*write a figure of the actual supply and demand curves*/
+            sprintf(fname, "%ssd%02d_%03d_000.fig", ec->id, d + 1, n_trades + 1);
+            PROF_START(PH_OUT_FIG);
+            TRACE_BEGIN("flush fig", d);
+            supdem(n_sell, sellers, n_buy, buyers, max_trades,
+                   &dummy_r1, &dummy_i, &dummy_r2,
+                   EQ_ACTUAL, fname, bounds, verbose);
+            TRACE_END("flush fig");
+            PROF_STOP(PH_OUT_FIG);
+        }
+
+        for (t = 0; t < max_trades; t++) { /*one trading session: either   a trade occurs or a fail is recorded*/
+            if (verbose) fprintf(stdout, "\nday %d trade %d\n", d, t + 1);
+
+            TRACE_BEGIN("trade", t);
+            m->trade(&(m->tdat[d][t]), sellers, buyers, ec, &(m->standing),
+                     max_surplus, &surplus, &status, verbose);
+            TRACE_END("trade");
+
+            /*this can generate *lots* of data-files*/
+            if ((verbose > 0) && m->figs && (e == 0)) /* first experiment?*/
+            { /*print a figure of the actual supply and demand curves*/
+                sprintf(fname,
+                        "%ssd%02d_%03d_%03d.fig", ec->id, d + 1, n_trades + 1, t + 1);
+                fprintf(stdout, "Writing %s\n", fname);
+                PROF_START(PH_OUT_FIG);
+                TRACE_BEGIN("flush fig", d);
+                supdem(n_sell, sellers, n_buy, buyers, max_trades,
+                       &dummy_r1, &dummy_i, &dummy_r2,
+                       EQ_ACTUAL, fname, bounds, verbose);
+                TRACE_END("flush fig");
+                PROF_STOP(PH_OUT_FIG);
+            }
+
+            /*calculate stats*/
+            if (status == DEAL) {
+                if (t > 0) last_price = price;
+                price = PRICE(m->tdat[d][t].deal_p);
+                if (t > 0) sum_price_diff += ((price - last_price) * (price - last_price));
+
+                pds = ((price - p_0) * (price - p_0));
+                (m->ats[n_trades]) += pds;
+                (m->ats_n[n_trades])++;
+                n_trades++;
+                sum_price += price;
+                sigmasum += pds;
+                alpha = (100 * sqrt(sigmasum / n_trades)) / p_0;
+                efficiency = (surplus / max_surplus) * 100;
+                if (verbose) {
+                    fprintf(stdout, "Day %d deal %d alpha=%f efficiency=%f\n",
+                            d, n_trades, alpha, efficiency);
+                }
+            } else {
+                if (status == END_DAY) /*give up*/
+                    t = max_trades;
+            }
+        } /*end of the trading session*/
+
+        /*record the data for this day*/
+        /*profit dispersion*/
+        pd = 0.0;
+        for (b = 0; b < n_buy; b++) {
+            diff = ((buyers[b].a_gain) - (buyers[b].t_gain));
+            pd += (diff * diff);
+        }
+        for (s = 0; s < n_sell; s++) {
+            diff = ((sellers[s].a_gain) - (sellers[s].t_gain));
+            pd += (diff * diff);
+        }
+        pdisp = sqrt((1 / ((Real) (n_buy + n_sell))) * pd);
+        if (verbose) fprintf(stdout, "Dispersion=%f\n", pdisp);
+
+        xd = r->day + d;
+        xd->n_trades = n_trades;
+        xd->sum_price = sum_price;
+        xd->alpha = alpha;
+        xd->pdisp = pdisp;
+        xd->effic = efficiency;
+        xd->pdiff = sum_price_diff;
+        ddat_strat_sums(sellers, n_sell, buyers, n_buy, xd->s_n, xd->s_a_gain, xd->s_t_gain);
+        MT_DAY_END(efficiency, alpha);
+        if (m->day_fn != NULL) m->day_fn(m->day_arg, e, d, xd);
+        if ((e == 0) && (d + 1 == m->warm_day)) { /*save what the traders have learned so far*/
+            warm_name(fname, ec->id);
+            fprintf(stdout, "Writing %s\n", fname);
+            warm_save(fname, buyers, n_buy, sellers, n_sell, d + 1);
+        }
+        TRACE_END("day");
+
+    } /*end   of the day loop*/
+    m->price = price;
+    m->alpha = alpha;
+    m->efficiency = efficiency;
+    for (t = 0; t < MAX_TRADES; t++) {
+        r->ats[t] = m->ats[t];
+        r->ats_n[t] = m->ats_n[t];
+    }
+    cache_put(m, e, r);
+    MT_EXP();
+
+    if (m->figs && (e == 0)) { /*plot the trade stats in xgraph format*/
+        for (d = 0; d < ec->n_days; d++) ddat_init(dd + d);
+        for (t = 0; t < MAX_TRADES; t++) {
+            ats_0[t].n = 0;
+            ats_0[t].sum = ats_0[t].sumsq = 0.0;
+        }
+        exp_add(r, dd, ats_0);
+        sprintf(fname, "%sresults.xg", ec->id);
+        PROF_START(PH_OUT_TRADE);
+        TRACE_BEGIN("flush results.xg", e);
+        xg_trades_graph(m->tdat, dd, ec->n_days, ec->max_trades, fname, n_exps);
+        TRACE_END("flush results.xg");
+        PROF_STOP(PH_OUT_TRADE);
+
+        /*plot this exp's per-trans rms deviation of deal price from equilib*/
+        sprintf(fname, "%sres_rms.xg", ec->id);
+        PROF_START(PH_OUT_RMS);
+        TRACE_BEGIN("flush res_rms.xg", e);
+        fp = fopen(fname, "w");
+        for (t = 0; t < ec->max_trades; t++) {
+            if (m->ats_n[t] > 0) {
+                fprintf(fp, "%d ", t + 1);
+                fprintf(fp, "%f \n", sqrt(m->ats[t] / m->ats_n[t]));
+            }
+        }
+        fclose(fp);
+        TRACE_END("flush res_rms.xg");
+        PROF_STOP(PH_OUT_RMS);
+    }
+    TRACE_END("experiment");
+}
+
+// exp-add: fold one experiment's results into the daily data and the per-trade stats over experiments
+void exp_add(Exp_result *r, Day_data ddat[], Real_stat ats_e[]) {
+    int d, t;
+    Real alphatrans;
+    Exp_day *xd;
+
+    for (d = 0; d < r->n_days; d++) {
+        xd = r->day + d;
+        ddat_update(ddat + d, xd->n_trades, xd->sum_price, xd->alpha, xd->pdisp, xd->effic, xd->pdiff);
+        ddat_strat_add(ddat + d, xd->s_n, xd->s_a_gain, xd->s_t_gain);
+    }
+
+    for (t = 0; t < r->max_trades; t++) {
+        if (r->ats_n[t] > 0) {
+            alphatrans = sqrt(r->ats[t] / r->ats_n[t]);
+            (ats_e[t].sum) += alphatrans;
+            (ats_e[t].sumsq) += (alphatrans * alphatrans);
+
+            (ats_e[t].n)++;
+        }
+    }
+}
+
+// run-graphs: plot the end-of-day stats and the per-trade stats over the n_exps experiments of a run
+void run_graphs(char id[], int n_days, int max_trades, int strat_mask, int n_exps,
+                Day_data ddat[], Real_stat ats_e[]) {
+    int t;
+    Real alphatrans; /*alpha over transaction sequence (cf G+S g6)*/
+    char fname[60];
+    FILE *fp;
+
+    /*plot the end-of-day stats in xgraph format*/
+    sprintf(fname, "%sres_day.xg", id);
+    PROF_START(PH_OUT_DAY);
+    TRACE_BEGIN("flush res_day.xg", -1);
+    xg_daily_graph(ddat, n_days, n_exps, fname);
+    TRACE_END("flush res_day.xg");
+    PROF_STOP(PH_OUT_DAY);
+
+    if (strat_mask & (strat_mask - 1)) { /*more than one strategy: plot each one's stats*/
+        sprintf(fname, "%sres_strat.xg", id);
+        xg_strat_graph(ddat, n_days, n_exps, strat_mask, fname);
+    }
+
+    /*plot per-trans rms deviation of deal price from equilib, over exps*/
+    sprintf(fname, "%sres_rms_avg.xg", id);
+    PROF_START(PH_OUT_AVG);
+    TRACE_BEGIN("flush res_rms_avg.xg", -1);
+    fp = fopen(fname, "w");
+    fprintf(fp, "TitleText: %s: n=%d\n\n", fname, n_exps);
+    /*mean*/
+    fprintf(fp, "\"Mean\n");
+    for (t = 0; t < max_trades; t++) {
+        if (ats_e[t].n > 0) {
+            fprintf(fp, "%d ", t + 1);
+            fprintf(fp, "%f \n", ats_e[t].sum / ats_e[t].n);
+        }
+    }
+    fprintf(fp, "\n");
+    /*+1 standard dev*/
+    fprintf(fp, "\"Mean+1sd\n");
+    for (t = 0; t < max_trades; t++) {
+        if (ats_e[t].n > 0) {
+            fprintf(fp, "%d ", t + 1);
+            alphatrans = ats_e[t].sum / ats_e[t].n;
+            fprintf(fp, "%f \n",
+                    alphatrans + sqrt((ats_e[t].sumsq / ats_e[t].n) - (alphatrans * alphatrans)));
+        }
+    }
+    fprintf(fp, "\n");
+    /*-1 standard dev*/
+    fprintf(fp, "\"Mean-1sd\n");
+    for (t = 0; t < max_trades; t++) {
+        if (ats_e[t].n > 0) {
+            fprintf(fp, "%d ", t + 1);
+            alphatrans = ats_e[t].sum / ats_e[t].n;
+            fprintf(fp, "%f \n",
+                    alphatrans - sqrt((ats_e[t].sumsq / ats_e[t].n) - (alphatrans * alphatrans)));
+        }
+    }
+    fprintf(fp, "\n");
+    /*n as a proportion of nexps*/
+    fprintf(fp, "\"n/n_exps\n");
+    for (t = 0; t < max_trades; t++) {
+        if (ats_e[t].n > 0) {
+            fprintf(fp, "%d ", t + 1);
+            fprintf(fp, "%f \n", ((Real) ats_e[t].n) / n_exps);
+        }
+    }
+    fclose(fp);
+    TRACE_END("flush res_rms_avg.xg");
+    PROF_STOP(PH_OUT_AVG);
+}
@@ -0,0 +1,99 @@
+//
+// market.h: the trading engine: one market running experiments, and what each experiment yields
+//
+// A Market holds everything one run of experiments changes: its own copy of the experiment (whose
+// schedule cursors move day by day), the traders, the learning parameters and the statistics carried
+// from one experiment to the next. Markets share nothing, so a sweep can run one per thread.
+//
+// An experiment's contribution to the daily and per-trade stats comes back as an Exp_result, which
+// exp_add() folds into them. Folding results in experiment order gives the same stats however and
+// wherever the experiments were run.
+//
+// Under the call-market rules (RULES_CALL) a day is a series of auctions rather than a stream of shouts.
+// At each, every active trader quotes, the quotes are cleared at the price where supply meets demand
+// (supdem() over the quotes: one sort of the book instead of a scan of the traders for every shout),
+// and every unit quoted on the right side of that price trades at it, unless the longer side has to be
+// rationed. The units matched are dealt one per trade(), so the daily and per-trade stats are kept as
+// they are for the continuous market, and a day's max_trades still caps its deals.
+//
+// Under the order-book rules (RULES_BOOK) shouts are chosen as in the continuous market, but each is an
+// order for all its trader's units that stays in the book (book.h) until it is filled, the trader shouts
+// again, or the day ends; the units an order fills are likewise dealt one per trade().
+
+// Call-book: the units matched at the last call-market auction and not yet dealt
+typedef struct a_call_book {
+    Cents price;                       /*the clearing price*/
+    int n, next;                       /*units matched, and the next to deal*/
+    int s[MAX_AGENTS * MAX_UNITS];     /*the seller and buyer of each: two units of one trader appear twice*/
+    int b[MAX_AGENTS * MAX_UNITS];
+} Call_book;
+
+// Standing: what the market rules keep from one trade to the next within a day
+typedef struct a_standing {
+    Call_book call;              /*RULES_CALL*/
+    Order_book book;             /*RULES_BOOK*/
+} Standing;
+
+// Trade-fn: trade() specialised for one setting of the market rules
+typedef void (*Trade_fn)(Trade_data *, Agent [], Agent [], Expctl *, Standing *, Real, Real *, int *, int);
+
+// Exp-day: what one day of one experiment adds to the daily stats
+typedef struct exp_day {
+    int n_trades;                /*deals done*/
+    Real sum_price;              /*sum of deal prices*/
+    Real alpha;                  /*Smith's alpha after the last deal*/
+    Real pdisp;                  /*profit dispersion*/
+    Real effic;                  /*efficiency after the last deal*/
+    Real pdiff;                  /*sum of squared differences between successive deal prices*/
+    int s_n[MAX_STRAT];          /*agents of each strategy*/
+    Real s_a_gain[MAX_STRAT];    /*their actual gains*/
+    Real s_t_gain[MAX_STRAT];    /*their theoretical gains*/
+} Exp_day;
+
+// Day-fn: called as each day of an experiment ends, with the market's day_arg, the experiment, the day and
+// what the day adds to the daily stats
+typedef void (*Day_fn)(void *, int, int, Exp_day *);
+
+// Exp-result: what one experiment adds to the results of a run
+typedef struct exp_result {
+    int n_days, max_trades;
+    Exp_day day[MAX_N_DAYS];
+    Real ats[MAX_TRADES];        /*squared deviations from equilibrium of the t-th deal of a day, summed*/
+    int ats_n[MAX_TRADES];       /*and how many deals they were*/
+} Exp_result;
+
+// Market: one experiment file under one set of parameters, and the state of a run on it
+typedef struct a_market {
+    Expctl ec;                   /*the experiment: this market's own copy*/
+    Zip_params zp;               /*the ZIP traders' learning parameters*/
+    Trade_fn trade;              /*trade() specialised for ec's rules*/
+    int verbose;
+    int figs;                    /*boolean: draw the first experiment's figures and trade graphs?*/
+    int indep;                   /*boolean: seed experiment e with rs+e, clearing what the last one left?*/
+    int rs;                      /*random seed*/
+    struct a_warm *warm;         /*start every experiment's traders from this saved state (warm.h), if any*/
+    Real jitter;                 /*scaling each saved margin by a random factor in [1-jitter, 1+jitter]*/
+    int warm_day;                /*save the first experiment's traders at the end of this day (0: never)*/
+    int crn;                     /*boolean: draw from common random numbers, keyed by experiment and use?*/
+    int anti;                    /*boolean: and make each odd experiment the antithetic twin of the one before?*/
+    Day_fn day_fn;               /*if set, called as each day ends*/
+    void *day_arg;
+    /*carried from one experiment to the next, unless indep*/
+    Real price, alpha, efficiency;
+    Real ats[MAX_TRADES];
+    int ats_n[MAX_TRADES];
+    /*working storage*/
+    Agent buyers[MAX_AGENTS], sellers[MAX_AGENTS];
+    Trade_data tdat[MAX_N_DAYS][MAX_TRADES];
+    Standing standing;           /*cleared at the start of each day*/
+} Market;
+
+Trade_fn trade_select(Expctl *);
+
+void market_init(Market *, int rs, int verbose);
+
+void market_exp(Market *, int e, int n_exps, Exp_result *);
+
+void exp_add(Exp_result *, Day_data [], Real_stat []);
+
+void run_graphs(char [], int, int, int, int, Day_data [], Real_stat []);
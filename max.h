@@ -1,13 +1,30 @@
 // max.h: maxima for array bounds etc
+//
+// Any of these can be raised at build time, e.g. make CFLAGS='-O2 -DMAX_BUYERS=100000 -DMAX_SELLERS=100000'
 
 
+#ifndef MAX_N_DAYS
 #define MAX_N_DAYS 30
+#endif
+#ifndef MAX_TRADES
 #define MAX_TRADES 100
+#endif
 #define TOT_TRADES (MAX_N_DAYS*MAX_TRADES)
+#ifndef MAX_FAILS
 #define MAX_FAILS 100 /*maximum numbers of bids/offers al lowed to fail before day's trading closes*/
+#endif
+#ifndef MAX_BUYERS
 #define MAX_BUYERS 100
+#endif
+#ifndef MAX_SELLERS
 #define MAX_SELLERS 100
+#endif
 #define MAX_AGENTS (MAX_BUYERS>MAX_SELLERS?MAX_BUYERS:MAX_SELLERS)
+#ifndef MAX_UNITS
 #define MAX_UNITS 3 /*max no. of units an agent can sell/buy*/
+#endif
+#ifndef MAX_SCHED
 #define MAX_SCHED 2 /*max no. of supply or demand schedules in an experiment*/
-#define MAX_ID 30 /*max no. of chars in id tag used for output*/
\ No newline at end of file
+#endif
+#define MAX_ID 30 /*max no. of chars in id tag used for output*/
+#define MAX_STRAT 3 /*no. of trader strategies (see strategy.h)*/
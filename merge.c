@@ -0,0 +1,28 @@
+//
+// merge.c: merge the shard files of a run (see shard.h) into its graphs
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include   "max.h"
+#include   "random.h"
+#include   "agent.h"
+#include   "ddat.h"
+#include   "tdat.h"
+#include   "expctl.h"
+#include   "strategy.h"
+#include   "book.h"
+#include   "market.h"
+#include   "shard.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "\nUsage: merge <shardfile> ...\n");
+        fprintf(stderr, "  writes the run's <id>res_day.xg, <id>res_rms_avg.xg and, for mixed markets,\n");
+        fprintf(stderr, "  <id>res_strat.xg, exactly as one unsharded smith -e run would\n");
+        exit(0);
+    }
+    shard_merge(argc - 1, argv + 1);
+    return (1);
+}
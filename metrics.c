@@ -0,0 +1,310 @@
+//
+// metrics.c: per-thread counters and a Prometheus text endpoint (see metrics.h)
+//
+// A thread's first count allocates its block and pushes it onto a global list with a compare-and-swap, as
+// trace.c does. Each field has one writer, its thread, which adds to it with a relaxed load and store rather
+// than a locked read-modify-write; the server thread only ever loads them, so it may see a block part-way
+// through an update, which is no matter for counters read a second apart.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "random.h"
+#include "pool.h"
+#include "metrics.h"
+
+#define MT_PAGE 16384 /*most bytes of one scrape's reply*/
+
+// Mt-block: what one thread has counted
+typedef struct mt_block {
+    atomic_long exps, days, shouts, trades;
+    atomic_int day;              /*the day being traded, from 1; 0 => none yet*/
+    _Atomic double effic, alpha; /*summed over the days traded*/
+    int tid;
+    struct mt_block *next;
+} __attribute__((aligned(64))) Mt_block; /*a cache line or more of its own*/
+
+int mt_on = 0;
+static _Atomic(Mt_block *) mt_blocks = NULL;
+static atomic_int mt_n_threads = 0;
+static _Thread_local Mt_block *mt_mine = NULL;
+static int mt_fd = -1;           /*the listening socket*/
+static char mt_path[108] = "";   /*its path, if a Unix-domain socket*/
+static struct timespec mt_t0;    /*when counting began*/
+
+// mt-block-get: this thread's block, registering it on first use
+static Mt_block *mt_block_get(void) {
+    Mt_block *b;
+
+    if (mt_mine != NULL) return (mt_mine);
+    if ((b = aligned_alloc(64, sizeof(Mt_block))) == NULL) {
+        fprintf(stderr, "\nFail: out of memory in metrics.c\n");
+        exit(0);
+    }
+    memset(b, 0, sizeof(Mt_block));
+    b->tid = atomic_fetch_add(&mt_n_threads, 1) + 1;
+    b->next = atomic_load(&mt_blocks);
+    while (!atomic_compare_exchange_weak(&mt_blocks, &(b->next), b));
+    mt_mine = b;
+    return (b);
+}
+
+// mt-add: add to a counter only this thread writes
+static inline void mt_add(atomic_long *c, long n) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+// metrics-shouts: count a trade()'s shouts, and the deals among them
+void metrics_shouts(int shouts, int trades) {
+    Mt_block *b = mt_block_get();
+
+    mt_add(&(b->shouts), shouts);
+    mt_add(&(b->trades), trades);
+}
+
+// metrics-day: note that day d (from 0) has begun
+void metrics_day(int d) {
+    atomic_store_explicit(&(mt_block_get()->day), d + 1, memory_order_relaxed);
+}
+
+// metrics-day-end: count a day ended, with the efficiency and alpha it ended on
+void metrics_day_end(Real effic, Real alpha) {
+    Mt_block *b = mt_block_get();
+
+    mt_add(&(b->days), 1);
+    atomic_store_explicit(&(b->effic), atomic_load_explicit(&(b->effic), memory_order_relaxed) + effic,
+                          memory_order_relaxed);
+    atomic_store_explicit(&(b->alpha), atomic_load_explicit(&(b->alpha), memory_order_relaxed) + alpha,
+                          memory_order_relaxed);
+}
+
+// metrics-exp: count an experiment finished
+void metrics_exp(void) {
+    mt_add(&(mt_block_get()->exps), 1);
+}
+
+// mt-secs: seconds since counting began
+static double mt_secs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((ts.tv_sec - mt_t0.tv_sec) + (ts.tv_nsec - mt_t0.tv_nsec) * 1e-9);
+}
+
+// mt-rss: the process's resident set in bytes, or 0 if it can't be had
+static long mt_rss(void) {
+    long pages = 0;
+    FILE *fp;
+
+    if ((fp = fopen("/proc/self/statm", "r")) == NULL) return (0);
+    if (fscanf(fp, "%*s %ld", &pages) != 1) pages = 0;
+    fclose(fp);
+    return (pages * sysconf(_SC_PAGESIZE));
+}
+
+// Mt-page: a reply being written
+typedef struct mt_page {
+    char buf[MT_PAGE];
+    int len;
+} Mt_page;
+
+// mt-put: append to a reply, dropping what won't fit
+static void mt_put(Mt_page *pg, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void mt_put(Mt_page *pg, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    if (pg->len >= MT_PAGE) return;
+    va_start(ap, fmt);
+    n = vsnprintf(pg->buf + pg->len, MT_PAGE - pg->len, fmt, ap);
+    va_end(ap);
+    pg->len += n;
+    if (pg->len > MT_PAGE) pg->len = MT_PAGE;
+}
+
+// mt-head: a metric's help and type lines
+static void mt_head(Mt_page *pg, char name[], char type[], char help[]) {
+    mt_put(pg, "# HELP zip_%s %s\n# TYPE zip_%s %s\n", name, help, name, type);
+}
+
+// mt-scrape: write every metric to a reply; rates are over the time since the last scrape
+static void mt_scrape(Mt_page *pg) {
+    static double last_t = 0.0;
+    static long last_shouts = 0, last_trades = 0;
+    Mt_block *b, *first = atomic_load(&mt_blocks);
+    long days = 0, shouts = 0, trades = 0;
+    double effic = 0.0, alpha = 0.0, t, dt;
+
+    for (b = first; b != NULL; b = b->next) {
+        days += atomic_load_explicit(&(b->days), memory_order_relaxed);
+        shouts += atomic_load_explicit(&(b->shouts), memory_order_relaxed);
+        trades += atomic_load_explicit(&(b->trades), memory_order_relaxed);
+        effic += atomic_load_explicit(&(b->effic), memory_order_relaxed);
+        alpha += atomic_load_explicit(&(b->alpha), memory_order_relaxed);
+    }
+    t = mt_secs();
+    dt = t - last_t;
+
+    pg->len = 0;
+    mt_head(pg, "experiments_total", "counter", "Experiments finished.");
+    for (b = first; b != NULL; b = b->next)
+        mt_put(pg, "zip_experiments_total{thread=\"%d\"} %ld\n", b->tid, atomic_load_explicit(&(b->exps),
+                                                                                               memory_order_relaxed));
+    mt_head(pg, "days_total", "counter", "Trading days finished.");
+    mt_put(pg, "zip_days_total %ld\n", days);
+    mt_head(pg, "shouts_total", "counter", "Bids and offers shouted.");
+    for (b = first; b != NULL; b = b->next)
+        mt_put(pg, "zip_shouts_total{thread=\"%d\"} %ld\n", b->tid, atomic_load_explicit(&(b->shouts),
+                                                                                          memory_order_relaxed));
+    mt_head(pg, "trades_total", "counter", "Deals done.");
+    for (b = first; b != NULL; b = b->next)
+        mt_put(pg, "zip_trades_total{thread=\"%d\"} %ld\n", b->tid, atomic_load_explicit(&(b->trades),
+                                                                                          memory_order_relaxed));
+    mt_head(pg, "trades_per_second", "gauge", "Deals done per second since the last scrape.");
+    mt_put(pg, "zip_trades_per_second %g\n", (dt > 0.0 ? (trades - last_trades) / dt : 0.0));
+    mt_head(pg, "shouts_per_second", "gauge", "Shouts per second since the last scrape.");
+    mt_put(pg, "zip_shouts_per_second %g\n", (dt > 0.0 ? (shouts - last_shouts) / dt : 0.0));
+    mt_head(pg, "fail_ratio", "gauge", "Fraction of shouts that found no taker, since the last scrape.");
+    mt_put(pg, "zip_fail_ratio %g\n",
+           (shouts > last_shouts ? 1.0 - (double) (trades - last_trades) / (shouts - last_shouts) : 0.0));
+    mt_head(pg, "day", "gauge", "The day each thread is trading, from 1.");
+    for (b = first; b != NULL; b = b->next)
+        mt_put(pg, "zip_day{thread=\"%d\"} %d\n", b->tid, atomic_load_explicit(&(b->day), memory_order_relaxed));
+    mt_head(pg, "efficiency_mean", "gauge", "Mean efficiency at the end of a day, over the days finished.");
+    mt_put(pg, "zip_efficiency_mean %g\n", (days > 0 ? effic / days : 0.0));
+    mt_head(pg, "alpha_mean", "gauge", "Mean Smith's alpha at the end of a day, over the days finished.");
+    mt_put(pg, "zip_alpha_mean %g\n", (days > 0 ? alpha / days : 0.0));
+    mt_head(pg, "pool_queue_depth", "gauge", "Jobs handed to the thread pool and not yet started.");
+    mt_put(pg, "zip_pool_queue_depth %d\n", pool_waiting());
+    mt_head(pg, "resident_bytes", "gauge", "Resident set size.");
+    mt_put(pg, "zip_resident_bytes %ld\n", mt_rss());
+    mt_head(pg, "uptime_seconds", "gauge", "Seconds since counting began.");
+    mt_put(pg, "zip_uptime_seconds %g\n", t);
+
+    last_t = t;
+    last_shouts = shouts;
+    last_trades = trades;
+}
+
+// mt-write: write all of len bytes, giving up if the client has gone
+static void mt_write(int fd, const char *p, long len) {
+    long n;
+
+    while (len > 0) {
+        n = send(fd, p, len, MSG_NOSIGNAL);
+        if ((n < 0) && (errno == EINTR)) continue;
+        if (n <= 0) return;
+        p += n;
+        len -= n;
+    }
+}
+
+// mt-serve: answer HTTP requests one at a time: GET / or /metrics gets the metrics, anything else 404
+static void *mt_serve(void *arg) {
+    static Mt_page pg;
+    char req[1024], head[256];
+    struct timeval patience = {1, 0};
+    int fd, n, got, ok;
+
+    for (;;) {
+        if ((fd = accept(mt_fd, NULL, NULL)) < 0) {
+            if (errno == EINTR) continue;
+            break; /*the socket has been closed*/
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &patience, sizeof(patience)); /*a stalled client can't block the rest*/
+        got = 0;
+        req[0] = '\0';
+        while ((got < (int) sizeof(req) - 1) && (strstr(req, "\r\n\r\n") == NULL)) {
+            if ((n = read(fd, req + got, sizeof(req) - 1 - got)) <= 0) break;
+            got += n;
+            req[got] = '\0';
+        }
+        ok = ((strncmp(req, "GET / ", 6) == 0) || (strncmp(req, "GET /metrics ", 13) == 0) ||
+              (strncmp(req, "GET /metrics?", 13) == 0));
+        if (ok) {
+            mt_scrape(&pg);
+            n = snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                             "Content-Length: %d\r\nConnection: close\r\n\r\n", pg.len);
+            mt_write(fd, head, n);
+            mt_write(fd, pg.buf, pg.len);
+        } else {
+            n = snprintf(head, sizeof(head), "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            mt_write(fd, head, n);
+        }
+        close(fd);
+    }
+    return (NULL);
+}
+
+// mt-unlink: remove the Unix-domain socket as the program exits
+static void mt_unlink(void) {
+    if (mt_path[0] != '\0') unlink(mt_path);
+}
+
+// metrics-start: start counting, and serve the counts at where: a port on 127.0.0.1, or a socket path
+int metrics_start(char where[]) {
+    struct sockaddr_in in;
+    struct sockaddr_un un;
+    struct stat st;
+    pthread_t server;
+    char *end;
+    long port;
+    int one = 1, ok;
+
+    port = strtol(where, &end, 10);
+    if ((*end == '\0') && (end != where)) { /*a port*/
+        if ((port < 1) || (port > 65535)) {
+            fprintf(stderr, "\nFail: -M %s isn't a port\n", where);
+            exit(0);
+        }
+        memset(&in, 0, sizeof(in));
+        in.sin_family = AF_INET;
+        in.sin_port = htons((unsigned short) port);
+        in.sin_addr.s_addr = htonl(INADDR_LOOPBACK); /*local only: the counts aren't for the world*/
+        ok = ((mt_fd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+        if (ok) setsockopt(mt_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        ok = ok && (bind(mt_fd, (struct sockaddr *) &in, sizeof(in)) == 0);
+    } else {
+        if (strlen(where) >= sizeof(un.sun_path)) {
+            fprintf(stderr, "\nFail: -M %s: socket path too long\n", where);
+            exit(0);
+        }
+        if ((stat(where, &st) == 0) && S_ISSOCK(st.st_mode)) unlink(where); /*left by an earlier run*/
+        memset(&un, 0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        strcpy(un.sun_path, where);
+        ok = ((mt_fd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0);
+        ok = ok && (bind(mt_fd, (struct sockaddr *) &un, sizeof(un)) == 0);
+        if (ok) {
+            strcpy(mt_path, where);
+            atexit(mt_unlink);
+        }
+    }
+    if ((!ok) || (listen(mt_fd, 16) != 0)) {
+        fprintf(stderr, "\nFail: can't serve metrics on %s (%s)\n", where, strerror(errno));
+        exit(0);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &mt_t0);
+    mt_on = 1;
+    if (pthread_create(&server, NULL, mt_serve, NULL) != 0) {
+        fprintf(stderr, "\nFail: can't start the metrics thread\n");
+        exit(0);
+    }
+    pthread_detach(server);
+    fprintf(stdout, "Metrics on %s\n", where);
+    return (1);
+}
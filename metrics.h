@@ -0,0 +1,25 @@
+//
+// metrics.h: live counters of a run, served in Prometheus text format while it runs
+//
+// "smith -M where" starts a thread answering HTTP requests at where: port where on 127.0.0.1 if it is a number,
+// else a Unix-domain socket at that path (curl --unix-socket where http://localhost/metrics). Each thread counts
+// into a block of its own, which only it writes, with relaxed atomic loads and stores: no locks and no contended
+// cache lines, so counting costs a few adds per shout. A scrape sums the blocks. Unless -M is given nothing is
+// counted, and the MT_ macros cost a test of mt_on.
+
+extern int mt_on; /*boolean: counting?*/
+
+int metrics_start(char []);
+
+void metrics_shouts(int, int);
+
+void metrics_day(int);
+
+void metrics_day_end(Real, Real);
+
+void metrics_exp(void);
+
+#define MT_SHOUTS(shouts, trades) do { if (mt_on) metrics_shouts(shouts, trades); } while (0)
+#define MT_DAY(d) do { if (mt_on) metrics_day(d); } while (0)
+#define MT_DAY_END(effic, alpha) do { if (mt_on) metrics_day_end(effic, alpha); } while (0)
+#define MT_EXP() do { if (mt_on) metrics_exp(); } while (0)
@@ -0,0 +1,194 @@
+//
+// multi.c: run many independent markets side by side in one process (see multi.h)
+//
+// The markets are run as a batch (batch.h), as a sweep's points are, so the long experiments of big
+// markets start early and the short ones of small markets fill in around them. A market's experiments
+// are folded into its stats in experiment order once the last of them is done, so its graphs are those it
+// would get run on its own with -e, whatever the number of threads.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "ddat.h"
+#include "tdat.h"
+#include "expctl.h"
+#include "strategy.h"
+#include "book.h"
+#include "market.h"
+#include "pool.h"
+#include "batch.h"
+#include "multi.h"
+
+#define MU_LINE 1024 /*longest line in a manifest*/
+
+// Mu-stats: one market's stats over its experiments
+typedef struct mu_stats {
+    Day_data dd[MAX_N_DAYS];
+    Real_stat ats_e[MAX_TRADES];
+} Mu_stats;
+
+// Mu-run: a multi-market run in progress, shared by the threads running its jobs
+typedef struct mu_run {
+    Multi *mu;
+    int n_exps;
+    int crn, anti;
+    Mu_stats *stats;
+} Mu_run;
+
+static _Thread_local Market *mu_market = NULL; /*each thread's market*/
+
+// multi-read: read a manifest and the experiment files it names, setting each market up to be seeded
+// from rs
+void multi_read(char filename[], Multi *mu, int rs) {
+    FILE *fp;
+    char line[MU_LINE], *tok;
+    int k, size = 0;
+    Market *m;
+
+    if ((fp = fopen(filename, "r")) == NULL) {
+        fprintf(stderr, "\nFail: can't open manifest %s\n", filename);
+        exit(0);
+    }
+
+    mu->n = 0;
+    mu->m = NULL;
+    while (fgets(line, MU_LINE, fp) != NULL) {
+        if ((tok = strtok(line, " \t\r\n")) == NULL) continue;
+        if (tok[0] == '#') continue;
+        if (mu->n == size) {
+            size = (size == 0 ? 16 : 2 * size);
+            if ((mu->m = realloc(mu->m, size * sizeof(Market *))) == NULL) {
+                fprintf(stderr, "\nFail: can't allocate a manifest of %d markets\n", size);
+                exit(0);
+            }
+        }
+        if ((m = malloc(sizeof(Market))) == NULL) {
+            fprintf(stderr, "\nFail: can't allocate a market for %s\n", tok);
+            exit(0);
+        }
+        expctl_in(tok, &(m->ec), 0);
+        for (k = 0; k < mu->n; k++) {
+            if (!strcmp(mu->m[k]->ec.id, m->ec.id)) {
+                fprintf(stderr, "\nFail: %s has the id %s, as market %d does\n", tok, m->ec.id, k);
+                exit(0);
+            }
+        }
+        market_init(m, rs, 0);
+        m->figs = 0;
+        m->indep = 1;
+        mu->m[(mu->n)++] = m;
+    }
+    fclose(fp);
+
+    if (mu->n == 0) {
+        fprintf(stderr, "\nFail: no markets in %s\n", filename);
+        exit(0);
+    }
+}
+
+// multi-name: the name of the combined table for a manifest: <manifest>multi.dat, the manifest's name
+// taken without its directory or extension
+void multi_name(char fname[], char manifest[]) {
+    char stem[MAX_ID], *p;
+
+    if ((p = strrchr(manifest, '/')) != NULL) manifest = p + 1;
+    strncpy(stem, manifest, MAX_ID - 1);
+    stem[MAX_ID - 1] = '\0';
+    if ((p = strchr(stem, '.')) != NULL) *p = '\0';
+    sprintf(fname, "%smulti.dat", stem);
+}
+
+// mu-fold: fold the finished experiments of market k into its stats, in experiment order
+static void mu_fold(void *arg, int k, Market *m, Exp_result res[]) {
+    Mu_run *run = arg;
+    int d, e, t;
+    Mu_stats *st = run->stats + k;
+
+    for (d = 0; d < run->mu->m[k]->ec.n_days; d++) ddat_init(st->dd + d);
+    for (t = 0; t < MAX_TRADES; t++) {
+        st->ats_e[t].n = 0;
+        st->ats_e[t].sum = st->ats_e[t].sumsq = 0.0;
+    }
+    for (e = 0; e < run->n_exps; e++) exp_add(res + e, st->dd, st->ats_e);
+    fprintf(stdout, "market %s done\n", run->mu->m[k]->ec.id);
+}
+
+// mu-setup: set this thread's market up as market k
+static Market *mu_setup(void *arg, int k) {
+    Mu_run *run = arg;
+    Market *m, *base = run->mu->m[k];
+
+    if (mu_market == NULL) {
+        if ((mu_market = malloc(sizeof(Market))) == NULL) {
+            fprintf(stderr, "\nFail: can't allocate a market for a multi-market thread\n");
+            exit(0);
+        }
+    }
+    m = mu_market;
+    m->ec = base->ec;
+    market_init(m, base->rs, 0);
+    m->figs = 0;
+    m->indep = 1;
+    m->crn = run->crn;
+    m->anti = run->anti;
+    return (m);
+}
+
+// multi-run: run n_exps experiments of every market of a manifest, shared out over the thread pool; write
+// each market's graphs, as a run of it alone would, and one row per market and day to the table fname
+void multi_run(Multi *mu, int n_exps, int crn, int anti, char fname[]) {
+    Mu_run run;
+    int k, d;
+    long *cost;
+    Market *m;
+    Day_data *dd;
+    FILE *fp;
+
+    run.mu = mu;
+    run.n_exps = n_exps;
+    run.crn = crn;
+    run.anti = anti;
+    cost = malloc(mu->n * sizeof(long));
+    run.stats = malloc(mu->n * sizeof(Mu_stats));
+    if ((cost == NULL) || (run.stats == NULL)) {
+        fprintf(stderr, "\nFail: can't allocate a run of %d markets\n", mu->n);
+        exit(0);
+    }
+
+    /*a market costs about (trades a day) x (agents) x (days)*/
+    for (k = 0; k < mu->n; k++) {
+        m = mu->m[k];
+        cost[k] = (long) m->ec.max_trades * (m->ec.dem_sched[0].n_agents + m->ec.sup_sched[0].n_agents) *
+                  m->ec.n_days;
+    }
+
+    fprintf(stdout, "%d markets x %d experiments on %d threads\n", mu->n, n_exps, pool_size());
+    batch_run(mu->n, n_exps, cost, mu_setup, mu_fold, &run);
+
+    fp = fopen(fname, "w");
+    fprintf(fp, "# market id day n_exps effic effic_sd alpha alpha_sd pdisp pdisp_sd quant quant_sd"
+                " price price_sd   (mean and s.d. over experiments)\n");
+    for (k = 0; k < mu->n; k++) {
+        m = mu->m[k];
+        for (d = 0; d < m->ec.n_days; d++) {
+            dd = run.stats[k].dd + d;
+            fprintf(fp, "%d %s %d %d", k, m->ec.id, d + 1, n_exps);
+            rstat_msd(fp, &(dd->effic));
+            rstat_msd(fp, &(dd->alpha));
+            rstat_msd(fp, &(dd->pdisp));
+            rstat_msd(fp, &(dd->quant));
+            rstat_msd(fp, &(dd->price));
+            fprintf(fp, "\n");
+        }
+        run_graphs(m->ec.id, m->ec.n_days, m->ec.max_trades, m->ec.strat_mask, n_exps, run.stats[k].dd,
+                   run.stats[k].ats_e);
+    }
+    fclose(fp);
+
+    free(cost);
+    free(run.stats);
+}
@@ -0,0 +1,21 @@
+//
+// multi.h: run many independent markets side by side in one process
+//
+// A manifest names the markets' experiment files (or images), one per line:
+//   # experiment files...
+//   wheat.dat
+//   copper.img
+// Each market gets n_exps experiments, seeded as with -e, and the graphs a run of it on its own would
+// write; the markets' ids must differ so that their graphs don't overwrite each other's.
+
+// Multi: the markets of a manifest, as read from their files
+typedef struct a_multi {
+    int n;                   /*number of markets*/
+    Market **m;
+} Multi;
+
+void multi_read(char [], Multi *, int rs);
+
+void multi_name(char [], char []);
+
+void multi_run(Multi *, int n_exps, int crn, int anti, char []);
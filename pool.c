@@ -0,0 +1,148 @@
+//
+// pool.c: a persistent pool of worker threads (see pool.h)
+//
+// A loop is published by bumping a generation count under the lock; each worker runs the chunk
+// matching its index (or, for pool_each(), takes items from a shared counter until they run out) and
+// the last one to finish wakes the caller.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+
+static pthread_t pl_threads[POOL_MAX];
+static pthread_mutex_t pl_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pl_go = PTHREAD_COND_INITIALIZER;   /*a new loop, or time to stop*/
+static pthread_cond_t pl_done = PTHREAD_COND_INITIALIZER; /*the last chunk has finished*/
+static int pl_size = 1;      /*threads in the pool, the caller included*/
+static long pl_gen = 0;      /*number of loops published*/
+static int pl_pending = 0;   /*chunks of the current loop still running*/
+static int pl_stop = 0;      /*workers should exit*/
+static Pool_fn pl_fn;        /*the current loop*/
+static void *pl_arg;
+static int pl_n, pl_chunks;  /*its number of items and of chunks*/
+static int pl_each;          /*boolean: hand out items one at a time rather than in chunks?*/
+static atomic_int pl_next;   /*the next item to hand out, for pool_each()*/
+static _Thread_local int pl_inside = 0; /*boolean: this thread is running an item of a loop?*/
+
+// pl-chunk: run chunk c of the current loop
+static void pl_chunk(int c) {
+    int first, last, i;
+
+    pl_inside = 1;
+    if (pl_each) {
+        while ((i = atomic_fetch_add(&pl_next, 1)) < pl_n) pl_fn(pl_arg, i, 1);
+    } else {
+        first = (int) (((long) pl_n * c) / pl_chunks);
+        last = (int) (((long) pl_n * (c + 1)) / pl_chunks);
+        if (last > first) pl_fn(pl_arg, first, last - first);
+    }
+    pl_inside = 0;
+}
+
+// pl-worker: wait for loops and run this worker's chunk of each
+static void *pl_worker(void *arg) {
+    int id = (int) (long) arg;
+    long seen = 0;
+
+    pthread_mutex_lock(&pl_lock);
+    for (;;) {
+        while ((pl_gen == seen) && (!pl_stop)) pthread_cond_wait(&pl_go, &pl_lock);
+        if (pl_stop) break;
+        seen = pl_gen;
+        if (id < pl_chunks) {
+            pthread_mutex_unlock(&pl_lock);
+            pl_chunk(id);
+            pthread_mutex_lock(&pl_lock);
+            if (--pl_pending == 0) pthread_cond_signal(&pl_done);
+        }
+    }
+    pthread_mutex_unlock(&pl_lock);
+    return (NULL);
+}
+
+// pool-start: start a pool of n threads, the caller included; returns the number actually running
+int pool_start(int n) {
+    int t, err;
+
+    if (n > POOL_MAX) n = POOL_MAX;
+    for (t = 1; t < n; t++) {
+        err = pthread_create(pl_threads + t, NULL, pl_worker, (void *) (long) t);
+        if (err) {
+            fprintf(stderr, "Could only start %d threads (%s)\n", t, strerror(err));
+            break;
+        }
+        pl_size = t + 1;
+    }
+    return (pl_size);
+}
+
+// pool-size: number of threads in the pool, the caller included
+int pool_size(void) {
+    return (pl_size);
+}
+
+// pl-publish: run a loop of n items on chunks threads, the caller included
+static void pl_publish(Pool_fn fn, void *arg, int n, int chunks, int each) {
+    pthread_mutex_lock(&pl_lock);
+    pl_fn = fn;
+    pl_arg = arg;
+    pl_n = n;
+    pl_chunks = chunks;
+    pl_each = each;
+    atomic_store(&pl_next, 0);
+    pl_pending = chunks - 1;
+    pl_gen++;
+    pthread_cond_broadcast(&pl_go);
+    pthread_mutex_unlock(&pl_lock);
+
+    pl_chunk(0);
+
+    pthread_mutex_lock(&pl_lock);
+    while (pl_pending > 0) pthread_cond_wait(&pl_done, &pl_lock);
+    pthread_mutex_unlock(&pl_lock);
+}
+
+// pool-run: run fn over items [0, n), shared out over the pool in contiguous chunks
+void pool_run(Pool_fn fn, void *arg, int n) {
+    int chunks;
+
+    chunks = n / POOL_GRAIN;
+    if (chunks > pl_size) chunks = pl_size;
+    if ((chunks < 2) || pl_inside) { /*not worth waking anyone, or everyone is busy with an outer loop*/
+        if (n > 0) fn(arg, 0, n);
+        return;
+    }
+    pl_publish(fn, arg, n, chunks, 0);
+}
+
+// pool-each: run fn on items 0, 1, ... n-1 one at a time, each thread taking the next item as soon
+// as it is free, so that long items don't hold up the rest
+void pool_each(Pool_fn fn, void *arg, int n) {
+    pl_publish(fn, arg, n, pl_size, 1);
+}
+
+// pool-waiting: items of the current pool_each() loop not yet taken by a thread
+int pool_waiting(void) {
+    int n = 0;
+
+    pthread_mutex_lock(&pl_lock);
+    if (pl_each && (pl_pending > 0)) n = pl_n - atomic_load(&pl_next);
+    pthread_mutex_unlock(&pl_lock);
+    return (n > 0 ? n : 0);
+}
+
+// pool-stop: stop the workers and wait for them to exit
+void pool_stop(void) {
+    int t;
+
+    pthread_mutex_lock(&pl_lock);
+    pl_stop = 1;
+    pthread_cond_broadcast(&pl_go);
+    pthread_mutex_unlock(&pl_lock);
+    for (t = 1; t < pl_size; t++) pthread_join(pl_threads[t], NULL);
+    pl_size = 1;
+    pl_stop = 0;
+}
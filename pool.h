@@ -0,0 +1,26 @@
+//
+// pool.h: a persistent pool of worker threads for sharing out loops over agents
+//
+// The workers are started once and then wait to be handed a loop; pool_run() splits its n items into
+// one contiguous chunk per thread, runs the first chunk itself and returns when every chunk is done.
+// Loops too short to repay waking the workers, or started from inside another loop, are run on the calling
+// thread alone. pool_each() is for
+// a few long items of uneven length: the threads take them one at a time, in order.
+
+#define POOL_MAX 64    /*most threads in the pool, the caller included*/
+#define POOL_GRAIN 512 /*fewest items worth giving a thread*/
+
+// Pool-fn: the body of a loop, run over items [first, first+n)
+typedef void (*Pool_fn)(void *arg, int first, int n);
+
+int pool_start(int);
+
+int pool_size(void);
+
+void pool_run(Pool_fn, void *, int);
+
+void pool_each(Pool_fn, void *, int);
+
+int pool_waiting(void);
+
+void pool_stop(void);
@@ -0,0 +1,334 @@
+//
+// prof.c: phase counters and log-bucketed latency histograms (see prof.h)
+//
+// Durations are measured in ticks of the cheapest clock available: the time-stamp counter on x86,
+// otherwise nanoseconds from the monotonic clock.
+//
+// Hardware counters are opened as one perf_event group led by the cycle counter, so a single read()
+// at each phase boundary snapshots all of them. Counters the kernel or the container refuses are
+// left out of the group; if the leader itself can't be opened the counters are switched off.
+//
+// Each thread times its phases in a table of its own, which its first PROF_START allocates and pushes
+// onto a global list with a compare-and-swap, as trace.c does with its buffers; prof_report() adds the
+// tables up, so it must only be called once the other threads have finished.
+
+#ifdef PROF
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TICK_UNIT "cycles"
+#else
+#define TICK_UNIT "ns"
+#endif
+
+#include "random.h"
+#include "prof.h"
+
+typedef unsigned long long Tick;
+
+// symbolic constants for the hardware counters
+#define HW_CYCLES 0
+#define HW_INSTRS 1
+#define HW_L1D_MISS 2
+#define HW_LLC_MISS 3
+#define HW_BR_MISS 4
+#define N_HW 5
+
+// Phase-stat: accumulated timings for one phase
+typedef struct phase_stat {
+    Tick start;                  /*tick count at the most recent PROF_START*/
+    Tick n;                      /*number of times the phase has run*/
+    Tick total;                  /*total ticks spent in the phase*/
+    Tick min, max;               /*shortest and longest single run*/
+    Tick hist[PROF_BUCKETS];     /*histogram of run lengths*/
+    Tick items;                  /*agents processed, for per-agent costs*/
+    Tick hw_start[N_HW];         /*counter values at the most recent PROF_START*/
+    Tick hw[N_HW];               /*counter totals*/
+} Phase_stat;
+
+// Prof-table: the phases timed by one thread
+typedef struct prof_table {
+    Phase_stat ph[N_PHASES];
+    struct prof_table *next;
+} Prof_table;
+
+static _Atomic(Prof_table *) pf_tables = NULL;
+static _Thread_local Phase_stat *phases = NULL; /*this thread's table*/
+
+static int hw_on = 0;           /*are hardware counters being sampled?*/
+static int hw_fd = -1;          /*group leader*/
+static int hw_slot[N_HW];       /*position of each counter in a group read; -1 => not available*/
+static int hw_n = 0;            /*number of counters in the group*/
+
+static char *hw_names[N_HW] = {"cycles", "instructions", "L1d-misses", "LLC-misses", "branch-misses"};
+
+static char *phase_names[N_PHASES] = {
+        "day_init", "theory_eq", "actual_eq", "shouter", "willing", "update",
+        "bank", "out_fig", "out_trades", "out_rms", "out_day", "out_rms_avg"
+};
+
+// ticks: read the clock
+static inline Tick ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return (__rdtsc());
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (((Tick) ts.tv_sec) * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+// bucket: log2 histogram bucket for a duration
+static inline int bucket(Tick t) {
+    int k = 0;
+
+    while (t) {
+        t >>= 1;
+        k++;
+    }
+    return (k < PROF_BUCKETS ? k : PROF_BUCKETS - 1);
+}
+
+#ifdef __linux__
+
+// hw-open-one: open one counter, as leader if group<0; returns the fd or -1
+static int hw_open_one(unsigned int type, unsigned long long config, int group) {
+    struct perf_event_attr pe;
+
+    memset(&pe, 0, sizeof(pe));
+    pe.size = sizeof(pe);
+    pe.type = type;
+    pe.config = config;
+    pe.disabled = (group < 0);
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    pe.read_format = PERF_FORMAT_GROUP;
+    return ((int) syscall(__NR_perf_event_open, &pe, 0, -1, group, 0));
+}
+
+// hw-read: snapshot the counter group into v[]
+static void hw_read(Tick v[N_HW]) {
+    unsigned long long buf[1 + N_HW];
+    int c;
+
+    if (read(hw_fd, buf, sizeof(buf)) < (ssize_t) (sizeof(buf[0]) * (1 + hw_n))) {
+        for (c = 0; c < N_HW; c++) v[c] = 0;
+        return;
+    }
+    for (c = 0; c < N_HW; c++) v[c] = (hw_slot[c] < 0) ? 0 : buf[1 + hw_slot[c]];
+}
+
+// prof-hwc-open: start sampling hardware counters; returns 1 if at least the cycle counter is available
+int prof_hwc_open(void) {
+    unsigned long long cfg[N_HW];
+    unsigned int type[N_HW];
+    int c, fd;
+
+    type[HW_CYCLES] = PERF_TYPE_HARDWARE;
+    cfg[HW_CYCLES] = PERF_COUNT_HW_CPU_CYCLES;
+    type[HW_INSTRS] = PERF_TYPE_HARDWARE;
+    cfg[HW_INSTRS] = PERF_COUNT_HW_INSTRUCTIONS;
+    type[HW_L1D_MISS] = PERF_TYPE_HW_CACHE;
+    cfg[HW_L1D_MISS] = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    type[HW_LLC_MISS] = PERF_TYPE_HARDWARE;
+    cfg[HW_LLC_MISS] = PERF_COUNT_HW_CACHE_MISSES;
+    type[HW_BR_MISS] = PERF_TYPE_HARDWARE;
+    cfg[HW_BR_MISS] = PERF_COUNT_HW_BRANCH_MISSES;
+
+    hw_fd = hw_open_one(type[HW_CYCLES], cfg[HW_CYCLES], -1);
+    if (hw_fd < 0) {
+        fprintf(stdout, "Hardware counters unavailable (%s): timing phases only\n", strerror(errno));
+        return (0);
+    }
+    hw_slot[HW_CYCLES] = 0;
+    hw_n = 1;
+    for (c = 1; c < N_HW; c++) {
+        fd = hw_open_one(type[c], cfg[c], hw_fd);
+        if (fd < 0) {
+            fprintf(stdout, "Hardware counter %s unavailable (%s)\n", hw_names[c], strerror(errno));
+            hw_slot[c] = -1;
+        } else hw_slot[c] = hw_n++;
+    }
+    ioctl(hw_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(hw_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    hw_on = 1;
+    return (1);
+}
+
+#else
+
+static void hw_read(Tick v[N_HW]) {}
+
+// prof-hwc-open: hardware counters are only supported on Linux
+int prof_hwc_open(void) {
+    fprintf(stdout, "Hardware counters unavailable on this platform: timing phases only\n");
+    return (0);
+}
+
+#endif
+
+// pf-table-new: allocate this thread's table and register it
+static void pf_table_new(void) {
+    Prof_table *t;
+
+    t = (Prof_table *) calloc(1, sizeof(Prof_table));
+    if (t == NULL) {
+        fprintf(stderr, "\nFail: out of memory in prof.c\n");
+        exit(0);
+    }
+    t->next = atomic_load(&pf_tables);
+    while (!atomic_compare_exchange_weak(&pf_tables, &(t->next), t));
+    phases = t->ph;
+}
+
+// prof-start: mark the start of a phase
+void prof_start(int ph) {
+    if (phases == NULL) pf_table_new();
+    if (hw_on) hw_read(phases[ph].hw_start);
+    phases[ph].start = ticks();
+}
+
+// prof-stop: mark the end of a phase and record its duration
+void prof_stop(int ph) {
+    Phase_stat *p = phases + ph;
+    Tick t = ticks() - p->start, v[N_HW];
+    int c;
+
+    if (hw_on) {
+        hw_read(v);
+        for (c = 0; c < N_HW; c++) p->hw[c] += v[c] - p->hw_start[c];
+    }
+    if ((p->n == 0) || (t < p->min)) p->min = t;
+    if (t > p->max) p->max = t;
+    p->total += t;
+    p->n++;
+    (p->hist[bucket(t)])++;
+}
+
+// prof-items: count the agents a phase has worked on
+void prof_items(int ph, int n) {
+    if (phases == NULL) pf_table_new();
+    phases[ph].items += n;
+}
+
+// per-item: a counter total per agent processed, or -1 if there is nothing to report
+static Real per_item(Phase_stat *p, int c) {
+    if ((p->items == 0) || (hw_slot[c] < 0)) return (-1.0);
+    return (((Real) p->hw[c]) / p->items);
+}
+
+// quantile: upper bound of the histogram bucket holding the q'th quantile
+static Tick quantile(Phase_stat *p, Real q) {
+    Tick want, seen = 0;
+    int k;
+
+    want = (Tick) (q * p->n);
+    if (want >= p->n) want = p->n - 1;
+    for (k = 0; k < PROF_BUCKETS; k++) {
+        seen += p->hist[k];
+        if (seen > want) break;
+    }
+    if (k == 0) return (0);
+    if ((k >= PROF_BUCKETS - 1) || (((1ULL << k) - 1) > p->max)) return (p->max);
+    return ((1ULL << k) - 1);
+}
+
+// pf-merge: add every thread's timings of a phase into p
+static void pf_merge(int ph, Phase_stat *p) {
+    Prof_table *t;
+    Phase_stat *q;
+    int k;
+
+    memset(p, 0, sizeof(Phase_stat));
+    for (t = atomic_load(&pf_tables); t != NULL; t = t->next) {
+        q = t->ph + ph;
+        if (q->n == 0) continue;
+        if ((p->n == 0) || (q->min < p->min)) p->min = q->min;
+        if (q->max > p->max) p->max = q->max;
+        p->n += q->n;
+        p->total += q->total;
+        p->items += q->items;
+        for (k = 0; k < N_HW; k++) p->hw[k] += q->hw[k];
+        for (k = 0; k < PROF_BUCKETS; k++) p->hist[k] += q->hist[k];
+    }
+}
+
+// prof-report: print the per-phase table, summed over threads, on stdout and dump the raw histograms to
+// <id>prof.dat
+void prof_report(char id[]) {
+    int ph, k;
+    Tick grand = 0;
+    Phase_stat *p, all[N_PHASES];
+    char fname[FILENAME_MAX];
+    FILE *fp;
+
+    for (ph = 0; ph < N_PHASES; ph++) pf_merge(ph, all + ph);
+    for (ph = 0; ph < N_PHASES; ph++) grand += all[ph].total;
+    if (grand == 0) grand = 1;
+
+    fprintf(stdout, "\nPhase breakdown (%s, inclusive):\n", TICK_UNIT);
+    fprintf(stdout, "%-12s %10s %14s %6s %10s %10s %10s %10s %12s\n",
+            "phase", "calls", "total", "%", "mean", "p50<=", "p90<=", "p99<=", "max");
+    for (ph = 0; ph < N_PHASES; ph++) {
+        p = all + ph;
+        if (p->n == 0) continue;
+        fprintf(stdout, "%-12s %10llu %14llu %6.2f %10.0f %10llu %10llu %10llu %12llu\n",
+                phase_names[ph], p->n, p->total, (100.0 * p->total) / grand,
+                ((Real) p->total) / p->n,
+                quantile(p, 0.5), quantile(p, 0.9), quantile(p, 0.99), p->max);
+    }
+
+    if (hw_on) {
+        fprintf(stdout, "\nHardware counters (per agent where a phase counts agents, -1 => n/a):\n");
+        fprintf(stdout, "%-12s %12s %6s %12s %12s %12s %12s\n",
+                "phase", "agents", "IPC", "cycles/ag", "L1d-miss/ag", "LLC-miss/ag", "br-miss/ag");
+        for (ph = 0; ph < N_PHASES; ph++) {
+            p = all + ph;
+            if (p->n == 0) continue;
+            fprintf(stdout, "%-12s %12llu %6.2f %12.1f %12.3f %12.3f %12.3f\n",
+                    phase_names[ph], p->items,
+                    ((p->hw[HW_CYCLES] > 0) && (hw_slot[HW_INSTRS] >= 0)) ?
+                    ((Real) p->hw[HW_INSTRS]) / p->hw[HW_CYCLES] : -1.0,
+                    per_item(p, HW_CYCLES), per_item(p, HW_L1D_MISS),
+                    per_item(p, HW_LLC_MISS), per_item(p, HW_BR_MISS));
+        }
+    }
+
+    /*one line per phase: name calls total min max, then the PROF_BUCKETS histogram counts*/
+    sprintf(fname, "%sprof.dat", id);
+    fp = fopen(fname, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "\nFail: can't write %s\n", fname);
+        return;
+    }
+    fprintf(fp, "# unit=%s buckets=%d hw=%d: phase calls total min max agents"
+                " cycles instructions L1d-misses LLC-misses branch-misses hist[0..%d]\n",
+            TICK_UNIT, PROF_BUCKETS, hw_on, PROF_BUCKETS - 1);
+    for (ph = 0; ph < N_PHASES; ph++) {
+        p = all + ph;
+        fprintf(fp, "%s %llu %llu %llu %llu %llu", phase_names[ph], p->n, p->total, p->min, p->max, p->items);
+        for (k = 0; k < N_HW; k++) fprintf(fp, " %llu", p->hw[k]);
+        for (k = 0; k < PROF_BUCKETS; k++) fprintf(fp, " %llu", p->hist[k]);
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+    fprintf(stdout, "Phase histograms written to %s\n", fname);
+}
+
+#endif
@@ -0,0 +1,47 @@
+//
+// prof.h: phase counters and latency histograms for finding where a run spends its time
+//
+// Everything here compiles away to nothing unless the program is built with -DPROF (make PROF=1).
+// PROF_START/PROF_STOP bracket one phase; phases may nest (day_init contains a supply/demand
+// calculation), so times are inclusive. PROF_ITEMS counts the agents a phase worked on, so costs
+// can be reported per agent. On Linux, prof_hwc_open() additionally samples hardware performance
+// counters at every phase boundary; if the kernel won't give us counters the run carries on without.
+
+// symbolic constants for the instrumented phases
+#define PH_DAY_INIT  0  /*day_init(): reset agents, theoretical equilibrium*/
+#define PH_THEORY_EQ 1  /*per-trade theoretical equilibrium in trade()*/
+#define PH_ACTUAL_EQ 2  /*per-trade actual equilibrium in trade()*/
+#define PH_SHOUTER   3  /*choosing an able shouter and getting its price*/
+#define PH_WILLING   4  /*searching for agents willing to take a shout*/
+#define PH_UPDATE    5  /*shout_update(): learning update of every agent*/
+#define PH_BANK      6  /*bank(): settling a deal*/
+#define PH_OUT_FIG   7  /*writing supply/demand .fig files*/
+#define PH_OUT_TRADE 8  /*writing results.xg*/
+#define PH_OUT_RMS   9  /*writing res_rms.xg*/
+#define PH_OUT_DAY   10 /*writing res_day.xg*/
+#define PH_OUT_AVG   11 /*writing res_rms_avg.xg*/
+#define N_PHASES     12
+
+#define PROF_BUCKETS 64 /*log2-spaced latency buckets: bucket k holds durations in [2^(k-1),2^k) ticks*/
+
+#ifdef PROF
+
+void prof_start(int);
+void prof_stop(int);
+void prof_items(int, int);
+int prof_hwc_open(void);
+void prof_report(char []);
+
+#define PROF_START(ph) prof_start(ph)
+#define PROF_STOP(ph) prof_stop(ph)
+#define PROF_ITEMS(ph, n) prof_items(ph, n)
+#define PROF_REPORT(id) prof_report(id)
+
+#else
+
+#define PROF_START(ph)
+#define PROF_STOP(ph)
+#define PROF_ITEMS(ph, n)
+#define PROF_REPORT(id)
+
+#endif
@@ -24,40 +24,44 @@
 #define   IA3 4561
 #define   IC3 51349
 
-float ran1(int *idum) {
-    static long ix1, ix2, ix3;
-    static float r[98];
+// ran1-r: ran1 with its state held in g rather than in statics
+float ran1_r(Ran1 *g, int *idum) {
     float temp;
-    static int iff = 0;
     int j;
     void nrerror();
 
-    if (*idum < 0 || iff == 0) {
-        iff = 1;
-        ix1 = (IC1 - (*idum)) % M1;
-        ix1 = (IA1 * ix1 + IC1) % M1;
-        ix2 = ix1 % M2;
-        ix1 = (IA1 * ix1 + IC1) % M1;
-        ix3 = ix1 % M3;
+    if (*idum < 0 || g->iff == 0) {
+        g->iff = 1;
+        g->ix1 = (IC1 - (*idum)) % M1;
+        g->ix1 = (IA1 * g->ix1 + IC1) % M1;
+        g->ix2 = g->ix1 % M2;
+        g->ix1 = (IA1 * g->ix1 + IC1) % M1;
+        g->ix3 = g->ix1 % M3;
         for (j = 1; j <= 97; j++) {
-            ix1 = (IA1 * ix1 + IC1) % M1;
-            ix2 = (IA2 * ix2 + IC2) % M2;
-            r[j] = (ix1 + ix2 * RM2) * RM1;
+            g->ix1 = (IA1 * g->ix1 + IC1) % M1;
+            g->ix2 = (IA2 * g->ix2 + IC2) % M2;
+            g->r[j] = (g->ix1 + g->ix2 * RM2) * RM1;
         }
         *idum = 1;
     }
-    ix1 = (IA1 * ix1 + IC1) % M1;
-    ix2 = (IA2 * ix2 + IC2) % M2;
-    ix3 = (IA3 * ix3 + IC3) % M3;
-    j = 1 + ((97 * ix3) / M3);
+    g->ix1 = (IA1 * g->ix1 + IC1) % M1;
+    g->ix2 = (IA2 * g->ix2 + IC2) % M2;
+    g->ix3 = (IA3 * g->ix3 + IC3) % M3;
+    j = 1 + ((97 * g->ix3) / M3);
     if (j > 97 || j < 1)
         /* nrerror("RAN1: This cannot happen."); */
         fprintf(stderr, "RAN1: This cannot happen.");
-    temp = r[j];
-    r[j] = (ix1 + ix2 * RM2) * RM1;
+    temp = g->r[j];
+    g->r[j] = (g->ix1 + g->ix2 * RM2) * RM1;
     return temp;
 }
 
+static _Thread_local Ran1 ran1_state; /*the generator behind ran1(): one per thread*/
+
+float ran1(int *idum) {
+    return (ran1_r(&ran1_state, idum));
+}
+
 #undef   M1
 #undef   IA1
 #undef   IC1
@@ -74,6 +78,114 @@ float ran1(int *idum) {
 // **********************************************
 // NB ran1 is not exported { it's masked by the following routines
 
+// rng-get: the generator behind randval() and irand() on this thread
+Ran1 *rng_get(void) {
+    return (&ran1_state);
+}
+
+// rseed-r: seed a given generator with s, without announcing it
+void rseed_r(Ran1 *g, int s) {
+    int seed = s * -1;
+
+    ran1_r(g, &seed);
+}
+
+// randval-r: as randval(), but drawing from a given generator
+Real randval_r(Ran1 *g, Real limit) {
+    int i = 1;
+
+    return (limit * ((Real) ran1_r(g, &i)));
+}
+
+// irand-r: as irand(), but drawing from a given generator
+int irand_r(Ran1 *g, int limit) {
+    int ir;
+
+    ir = limit;
+    while (ir == limit) { ir = (int) (floor(randval_r(g, (Real) limit))); }
+    return (ir);
+}
+
+// mix64: the splitmix64 finaliser, which scrambles every bit of x into every bit of the result
+static unsigned long long mix64(unsigned long long x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return (x ^ (x >> 31));
+}
+
+#define GOLDEN 0x9e3779b97f4a7c15ULL /*2^64 over the golden ratio: the splitmix64 increment*/
+
+// rkey-init: start the stream keyed by (a, b, c)
+void rkey_init(Rkey *k, long a, long b, long c) {
+    k->key = mix64(mix64(mix64((unsigned long long) a + GOLDEN) + (unsigned long long) b) + (unsigned long long) c);
+    k->n = 0;
+    k->anti = 0;
+}
+
+// randval-k: as randval(), but drawing the next value of a keyed stream
+Real randval_k(Rkey *k, Real limit) {
+    unsigned long long u;
+
+    (k->n)++;
+    /*the top 53 bits of the hash, as a fraction in [0,1)*/
+    u = mix64(k->key + (k->n * GOLDEN)) >> 11;
+    if (k->anti) u = ((1ULL << 53) - 1) - u;
+    return (limit * ((Real) u * (1.0 / 9007199254740992.0)));
+}
+
+// Under common random numbers each use of random numbers draws from its own keyed stream: the traders'
+// initial state from one per experiment, the rest from one per shout, so that one more or one fewer
+// draw in some shout doesn't put two configurations out of step for the rest of the experiment.
+static _Thread_local int crn_on = 0;
+static _Thread_local long crn_exp;
+static _Thread_local int crn_anti;
+static _Thread_local Rkey crn_key[RS_N];
+
+// crn-key-init: start the common stream for a use; negative third keys keep clear of the agents' streams
+static void crn_key_init(int use, long shout) {
+    rkey_init(crn_key + use, crn_exp, shout, -1 - use);
+    crn_key[use].anti = crn_anti;
+}
+
+// crn-start: draw this thread's randval_c() and irand_c() from the common streams of experiment exp
+void crn_start(long exp, int anti) {
+    int use;
+
+    crn_on = 1;
+    crn_exp = exp;
+    crn_anti = anti;
+    for (use = 0; use < RS_N; use++) crn_key_init(use, -1);
+}
+
+// crn-shout: move the per-shout common streams on to shout number shout
+void crn_shout(long shout) {
+    int use;
+
+    if (!crn_on) return;
+    for (use = RS_SHOUT; use < RS_N; use++) crn_key_init(use, shout);
+}
+
+// crn-stop: draw this thread's randval_c() and irand_c() from ran1 again
+void crn_stop(void) {
+    crn_on = 0;
+}
+
+// randval-c: randval() for a given use: from ran1, unless common random numbers are on
+Real randval_c(int use, Real limit) {
+    if (!crn_on) return (randval(limit));
+    return (randval_k(crn_key + use, limit));
+}
+
+// irand-c: irand() for a given use
+int irand_c(int use, int limit) {
+    int ir;
+
+    if (!crn_on) return (irand(limit));
+    ir = limit;
+    while (ir == limit) { ir = (int) (floor(randval_k(crn_key + use, (Real) limit))); }
+    return (ir);
+}
+
 // rseed: reseed the random number generator from the system clock if (*s)=0 then the system clock is used, otherwise the (*s) is used
 void rseed(int *s) {
     time_t tseed;
@@ -110,8 +222,8 @@ int irand(int limit) {
 
 // gaussrand: return a N (0; 1) deviate
 Real gaussrand(void) {
-    static int iset = 0;
-    static Real gset;
+    static _Thread_local int iset = 0; /*a deviate in hand: each thread's own*/
+    static _Thread_local Real gset;
     Real fac, r, v1, v2;
 
     if (iset == 0) {
@@ -9,9 +9,43 @@
 
 #define Real double
 
+// Ran1: the state of one generator, so that independent streams can run side by side
+typedef struct a_ran1 {
+    long ix1, ix2, ix3;
+    float r[98];
+    int iff;
+} Ran1;
+
+// Rkey: a counter-based stream: its n-th draw is a hash of its key and n, so a stream needs no state
+// beyond that and can be started anywhere, on any thread, without touching any other stream
+typedef struct a_rkey {
+    unsigned long long key;
+    unsigned long long n;
+    int anti;                    /*boolean: draw the antithetic 1-u of each value u?*/
+} Rkey;
+
+// symbolic constants for the uses of random numbers that get streams of their own under common random
+// numbers, so that configurations being compared draw the same numbers for the same purposes
+#define RS_INIT  0 /*traders' initial state*/
+#define RS_SHOUT 1 /*which trader shouts*/
+#define RS_MATCH 2 /*which willing trader takes a shout*/
+#define RS_QUOTE 3 /*zero-intelligence traders' quotes*/
+#define RS_N     4
+
 void rseed(int *); /*reseed random number generator*/
 Real randval(Real); /*return a (near)uniform distributed random number 2 [0; limit]*/
 int irand(int); /*return a random integer 2 f0; : : : ; limit ? 1g */
+Ran1 *rng_get(void); /*the generator behind randval() and irand() on this thread*/
+void rseed_r(Ran1 *, int); /*seed a given generator, quietly*/
+Real randval_r(Ran1 *, Real); /*randval() from a given generator*/
+int irand_r(Ran1 *, int); /*irand() from a given generator*/
+void rkey_init(Rkey *, long, long, long); /*start the stream keyed by three integers*/
+Real randval_k(Rkey *, Real); /*randval() from a keyed stream*/
+void crn_start(long, int); /*draw this thread's randval_c() from experiment's common streams, antithetic or not*/
+void crn_shout(long); /*move the common streams on to a given shout*/
+void crn_stop(void); /*draw this thread's randval_c() from ran1 again*/
+Real randval_c(int, Real); /*randval() for a given use: RS_...*/
+int irand_c(int, int); /*irand() for a given use*/
 Real gaussrand(void); /*returns a N (0; 1) random deviate*/
 
 // NB: abs(gaussrand()) will be > 3 about once in 400 trials (the 3 ?  rule).
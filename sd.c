@@ -6,6 +6,7 @@
 
 #include    <math.h>
 #include    <stdio.h>
+#include    <stdlib.h>
 #include    "random.h"
 #include    "agent.h"
 #include    "max.h"
@@ -43,31 +44,32 @@
 #define NULL_EQ -1 /*signifies no equilibrium price/quantity*/
 
 
-//sort: just bubble
-void sort(int order, int field, int n, Real l[][2]) {
-    int i, j, swap;
-    Real t;
+static _Thread_local int sort_field; /*column sort() orders by*/
 
+// price-cmp: order price pairs by the sort field, then by the other column, ascending
+static int price_cmp(const void *x, const void *y) {
+    const Cents *a = x, *b = y;
+
+    if (a[sort_field] != b[sort_field]) return (a[sort_field] < b[sort_field] ? -1 : 1);
+    if (a[1 - sort_field] != b[1 - sort_field]) return (a[1 - sort_field] < b[1 - sort_field] ? -1 : 1);
+    return (0);
+}
+
+// price-rcmp: the same, descending
+static int price_rcmp(const void *x, const void *y) {
+    return (price_cmp(y, x));
+}
+
+// sort: sort price pairs on one field, descending if order is set: qsort, so that the equilibrium of a
+// very large market doesn't cost a quadratic sort on every trade
+void sort(int order, int field, int n, Cents l[][2]) {
     if ((field < 0) || (field > 1)) {
         fprintf(stderr, "\nFail: bad field=%d in sort\n", field);
         exit(0);
     }
 
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < i; j++) {
-            if (order) { if (l[i][field] > l[j][field]) swap = 1; else swap = 0; }
-            else { if (l[i][field] < l[j][field]) swap = 1; else swap = 0; }
-
-            if (swap) {
-                t = l[i][0];
-                l[i][0] = l[j][0];
-                l[j][0] = t;
-                t = l[i][1];
-                l[i][1] = l[j][1];
-                l[j][1] = t;
-            }
-        }
-    }
+    sort_field = field;
+    qsort(l, n, sizeof(l[0]), order ? price_rcmp : price_cmp);
 }
 
 // xf-polyline: draw a polyline in x g
@@ -140,7 +142,7 @@ int neat_ticks(int range, int max_ticks) {
 
 // draw-axes: do the price and quantity axes dx and dy are returned with the number of pixels in a unit-step
 //   miny is baseline y value, maxy is max y value on graph
-void draw_axes(FILE *fp, int min_q, int max_q, Real min_p, Real max_p,
+void draw_axes(FILE *fp, int min_q, int max_q, Cents min_p, Cents max_p,
                int eq_p, int eq_q, int surplus, char fname[],
                int *dx, int *dy, int *miny, int *maxy) {
     int t, p,
@@ -149,8 +151,8 @@ void draw_axes(FILE *fp, int min_q, int max_q, Real min_p, Real max_p,
             tick_step,
             delta,
             imin_p, imax_p,
-            coords[MAX_POINTS][2],
             range;
+    static int coords[MAX_POINTS][2]; /*static: too big for the stack in a large market*/
     char labelstr[MAX_LABELLEN];
 
     /*draw the axes*/
@@ -184,8 +186,8 @@ void draw_axes(FILE *fp, int min_q, int max_q, Real min_p, Real max_p,
     xf_text(fp, AX_PTS, 0.0, LMARGIN_X + (int) (GRAPH_X * 0.4), Y_EQ_0 + 4 * TICK_X, labelstr);
 
     /*vertical axis:price*/
-    imin_p = (int) (100 * min_p);
-    imax_p = (int) (100 * max_p);
+    imin_p = min_p;
+    imax_p = max_p;
     range = imax_p - imin_p;
     tick_step = neat_ticks(range, Y_TICKS);
 
@@ -234,22 +236,31 @@ void supdem(int ns, Agent sellers[], int nb, Agent buyers[], int max_trades,
             Real *bounds, int verbose) {
     int maxn, a, s, b, no_intersect, not_found,
             q; /*quantity*/
-    Real sp[MAX_PRICES][2], /*seller limit and quote prices*/
-    bp[MAX_PRICES][2], /*buyer limit and quote prices*/
-    profit, tot_surp,
-            maxprice, minprice;
+    static _Thread_local Cents (*sp)[2] = NULL, /*seller limit and quote prices*/
+    (*bp)[2] = NULL;                                /*buyer limit and quote prices*/
+    Real profit, tot_surp;
+    Cents maxprice, minprice;
     FILE *fp;
 
     /*these declarations are for the xg drawing stuff */
     int p, /*point index*/
     min_q, max_q, /*minimum and maximum quantities on graph*/
-    dx, dy, tx, ty, miny, fy, maxy,
-            coords[MAX_POINTS][2]; /*coordinate points in polyline etc*/
+    dx, dy, tx, ty, miny, fy, maxy;
+    static int coords[MAX_POINTS][2]; /*coordinate points in polyline etc: only drawn on the main thread*/
     char labelstr[MAX_LABELLEN];
 
     *ep = -1.0;
     *iq = NULL_EQ;
 
+    if (sp == NULL) { /*each thread's own price tables, on the heap: too big for the stack in a large market*/
+        sp = malloc(MAX_PRICES * sizeof(sp[0]));
+        bp = malloc(MAX_PRICES * sizeof(bp[0]));
+        if ((sp == NULL) || (bp == NULL)) {
+            fprintf(stderr, "\nFail: can't allocate price tables in supdem()\n");
+            exit(0);
+        }
+    }
+
     if (((nb * MAX_UNITS) > MAX_PRICES) || ((ns * MAX_UNITS) > MAX_PRICES)) {
         fprintf(stderr, "\nFail: too many units in supdem() -- recompile\n");
         exit(0);
@@ -298,18 +309,18 @@ void supdem(int ns, Agent sellers[], int nb, Agent buyers[], int max_trades,
     if (verbose) {
         fprintf(stdout, "Max_trades=%d\n", max_trades);
         fprintf(stdout, "Minprice=%f maxprice=%f min_q=%d max_q=%d\n",
-                minprice, maxprice, min_q, max_q);
+                PRICE(minprice), PRICE(maxprice), min_q, max_q);
     }
 
     if (bounds != NULL) { /*autoscaling is OFF*/
         min_q = (int) (*bounds);
         max_q = (int) (*(bounds + 1));
-        minprice = *(bounds + 2);
-        maxprice = *(bounds + 3);
+        minprice = CENTS(*(bounds + 2));
+        maxprice = CENTS(*(bounds + 3));
         if (verbose) {
             fprintf(stdout, "Autoscaling is OFF. Bounds are:\n");
             fprintf(stdout, "Minprice=%f maxprice=%f min_q=%d max_q=%d\n",
-                    minprice, maxprice, min_q, max_q);
+                    PRICE(minprice), PRICE(maxprice), min_q, max_q);
         }
     }
 
@@ -321,27 +332,27 @@ void supdem(int ns, Agent sellers[], int nb, Agent buyers[], int max_trades,
         not_found = 1;
 
         for (q = 0; q < maxn; q++) { /*intersection?*/
-            profit = bp[q][field] - sp[q][field];
+            profit = PRICE(bp[q][field]) - PRICE(sp[q][field]);
             if (not_found) {
                 if (sp[q][field] > bp[q][field]) { /*straightforward intersect*/
-                    *ep = (sp[q - 1][field] + bp[q - 1][field]) / 2.0;
+                    *ep = (PRICE(sp[q - 1][field]) + PRICE(bp[q - 1][field])) / 2.0;
                     *iq = q;
                     not_found = 0;
                 } else {
                     if ((q + 1 == s) && (q + 1 == b)) { /*last buyer and seller*/
-                        *ep = (sp[q][field] + bp[q][field]) / 2.0;
+                        *ep = (PRICE(sp[q][field]) + PRICE(bp[q][field])) / 2.0;
                         *iq = q + 1;
                         if (q < max_trades) tot_surp += profit;
                         not_found = 0;
                     } else {
                         if ((q + 1) == s) { /*run out of active sellers but still some buyers*/
-                            *ep = (bp[q][field] + bp[q + 1][field]) / 2.0;
+                            *ep = (PRICE(bp[q][field]) + PRICE(bp[q + 1][field])) / 2.0;
                             *iq = q + 1;
                             if (q < max_trades) tot_surp += profit;
                             not_found = 0;
                         } else {
                             if ((q + 1) == b) { /*run out of active buyers but still some sellers*/
-                                (*ep) = (sp[q][field] + sp[q + 1][field]) / 2.0;
+                                (*ep) = (PRICE(sp[q][field]) + PRICE(sp[q + 1][field])) / 2.0;
                                 (*iq) = q + 1;
                                 if (q < max_trades) tot_surp += profit;
                                 not_found = 0;
@@ -359,10 +370,10 @@ void supdem(int ns, Agent sellers[], int nb, Agent buyers[], int max_trades,
 
             if (verbose) {
                 fprintf(stdout, "quantity %2d ", q + 1);
-                if (q < s) fprintf(stdout, "supply=%5.3f ", sp[q][field]);
+                if (q < s) fprintf(stdout, "supply=%5.3f ", PRICE(sp[q][field]));
                 else fprintf(stdout, "             ");
 
-                if (q < b) fprintf(stdout, "demand=%5.3f ", bp[q][field]);
+                if (q < b) fprintf(stdout, "demand=%5.3f ", PRICE(bp[q][field]));
                 else fprintf(stdout, "             ");
 
                 fprintf(stdout, "profit=%f cum.surp=%f ", profit, tot_surp);
@@ -404,9 +415,8 @@ void supdem(int ns, Agent sellers[], int nb, Agent buyers[], int max_trades,
         p = 0;
         for (q = 0; q < s; q++) {
             tx = LMARGIN_X + (q * dx);
-            xf_triangle(fp, tx, Y_EQ_0 - (int) (sp[q][0] * dy * 100) + (miny * dy),
-                        Y_EQ_0 - (int) (sp[q][1] * dy * 100) + (miny * dy), dx);
-            fy = Y_EQ_0 - (int) (sp[q][field] * dy * 100) + (miny * dy);
+            xf_triangle(fp, tx, Y_EQ_0 - (sp[q][0] * dy) + (miny * dy), Y_EQ_0 - (sp[q][1] * dy) + (miny * dy), dx);
+            fy = Y_EQ_0 - (sp[q][field] * dy) + (miny * dy);
             setcoords(coords, p++, tx, fy);
             setcoords(coords, p++, tx + dx, fy);
         }
@@ -418,9 +428,8 @@ void supdem(int ns, Agent sellers[], int nb, Agent buyers[], int max_trades,
         p = 0;
         for (q = 0; q < b; q++) {
             tx = LMARGIN_X + (q * dx);
-            xf_triangle(fp, tx, Y_EQ_0 - (int) (bp[q][0] * dy * 100) + (miny * dy),
-                        Y_EQ_0 - (int) (bp[q][1] * dy * 100) + (miny * dy), dx);
-            fy = Y_EQ_0 - (int) (bp[q][field] * dy * 100) + (miny * dy);
+            xf_triangle(fp, tx, Y_EQ_0 - (bp[q][0] * dy) + (miny * dy), Y_EQ_0 - (bp[q][1] * dy) + (miny * dy), dx);
+            fy = Y_EQ_0 - (bp[q][field] * dy) + (miny * dy);
             setcoords(coords, p++, tx, fy);
             setcoords(coords, p++, tx + dx, fy);
         }
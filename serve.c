@@ -0,0 +1,395 @@
+//
+// serve.c: run experiments for clients of a Unix-domain socket (see serve.h)
+//
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "ddat.h"
+#include "tdat.h"
+#include "expctl.h"
+#include "strategy.h"
+#include "book.h"
+#include "market.h"
+#include "sweep.h"
+#include "serve.h"
+
+#define SV_MSGLEN 200
+
+// Sv-conn: a client's connection, closed once the client has hung up and none of its requests are left
+typedef struct a_sv_conn {
+    int fd;
+    int refs;                    /*its reader, and each of its requests still running*/
+    int dead;                    /*boolean: a reply couldn't be sent: the client has gone*/
+    pthread_mutex_t wlock;       /*one reply at a time*/
+} Sv_conn;
+
+// Sv-job: a request being run
+typedef struct a_sv_job {
+    Sv_request rq;
+    Sv_conn *conn;
+    Expctl *ec;                  /*the experiment*/
+    Sweep point;                 /*the request's overrides, as a sweep of one point*/
+    int next;                    /*the next experiment to start*/
+    int left;                    /*experiments not yet finished*/
+    struct a_sv_job *nxt;        /*the next job with experiments to start*/
+} Sv_job;
+
+// Sv-day-arg: where a worker's days go
+typedef struct a_sv_day_arg {
+    Sv_job *job;
+} Sv_day_arg;
+
+static int sv_n_exps;            /*the experiments served, and their ids*/
+static Expctl *sv_exps;
+static pthread_mutex_t sv_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sv_work = PTHREAD_COND_INITIALIZER; /*a job has been added, or time to stop*/
+static Sv_job *sv_head = NULL;   /*the jobs with experiments to start, oldest first*/
+static Sv_job *sv_turn = NULL;   /*the job to take the next experiment from; NULL => the oldest*/
+static int sv_stop = 0;
+static volatile sig_atomic_t sv_quit = 0;
+
+// sv-send: send a reply, and a message after it if len>0; a client that has gone is just noted
+static void sv_send(Sv_conn *c, Sv_reply *r, char msg[]) {
+    char *p;
+    long n, left;
+    int part;
+
+    pthread_mutex_lock(&(c->wlock));
+    for (part = 0; (part < 2) && (!c->dead); part++) {
+        p = (part == 0 ? (char *) r : msg);
+        left = (part == 0 ? (long) sizeof(Sv_reply) : r->len);
+        while ((left > 0) && (!c->dead)) {
+            n = send(c->fd, p, left, MSG_NOSIGNAL);
+            if ((n < 0) && (errno == EINTR)) continue;
+            if (n <= 0) c->dead = 1;
+            else {
+                p += n;
+                left -= n;
+            }
+        }
+    }
+    pthread_mutex_unlock(&(c->wlock));
+}
+
+// sv-reply: start a reply to a request
+static void sv_reply(Sv_reply *r, int kind, int tag) {
+    memset(r, 0, sizeof(Sv_reply));
+    r->magic = SV_MAGIC;
+    r->kind = kind;
+    r->tag = tag;
+}
+
+// sv-error: answer a request that can't be run
+static void sv_error(Sv_conn *c, int tag, char msg[]) {
+    Sv_reply r;
+
+    sv_reply(&r, SV_ERROR, tag);
+    r.len = strlen(msg);
+    sv_send(c, &r, msg);
+}
+
+// sv-drop: let go of a connection, closing it if that was the last hold on it
+static void sv_drop(Sv_conn *c) {
+    int last;
+
+    pthread_mutex_lock(&sv_lock);
+    last = (--(c->refs) == 0);
+    pthread_mutex_unlock(&sv_lock);
+    if (last) {
+        close(c->fd);
+        pthread_mutex_destroy(&(c->wlock));
+        free(c);
+    }
+}
+
+// sv-day: send a day of an experiment as it ends
+static void sv_day(void *arg, int e, int d, Exp_day *xd) {
+    Sv_job *j = ((Sv_day_arg *) arg)->job;
+    Sv_reply r;
+
+    sv_reply(&r, SV_DAY, j->rq.tag);
+    r.exp = e;
+    r.day = d;
+    r.n_trades = xd->n_trades;
+    r.sum_price = xd->sum_price;
+    r.alpha = xd->alpha;
+    r.pdisp = xd->pdisp;
+    r.effic = xd->effic;
+    r.pdiff = xd->pdiff;
+    sv_send(j->conn, &r, NULL);
+}
+
+// sv-take: wait for an experiment to run, taking them from the jobs in turn; NULL => time to stop
+static Sv_job *sv_take(int *e) {
+    Sv_job *j, **pj;
+
+    pthread_mutex_lock(&sv_lock);
+    while ((sv_head == NULL) && (!sv_stop)) pthread_cond_wait(&sv_work, &sv_lock);
+    if (sv_stop) {
+        pthread_mutex_unlock(&sv_lock);
+        return (NULL);
+    }
+    j = (sv_turn != NULL ? sv_turn : sv_head);
+    *e = (j->next)++;
+    sv_turn = j->nxt;
+    if (j->next == j->rq.n_exps) { /*all its experiments started: out of the running*/
+        for (pj = &sv_head; *pj != j; pj = &((*pj)->nxt));
+        *pj = j->nxt;
+    }
+    pthread_mutex_unlock(&sv_lock);
+    return (j);
+}
+
+// sv-worker: run experiments for the clients, on a market of this thread's own
+static void *sv_worker(void *arg) {
+    Market *m;
+    Exp_result *r;
+    Sv_job *j;
+    Sv_reply done;
+    Sv_day_arg da;
+    int e, last;
+
+    m = malloc(sizeof(Market));
+    r = malloc(sizeof(Exp_result));
+    if ((m == NULL) || (r == NULL)) {
+        fprintf(stderr, "\nFail: can't allocate a market for a server thread\n");
+        exit(0);
+    }
+    while ((j = sv_take(&e)) != NULL) {
+        if (!(j->conn->dead)) { /*no one to tell, otherwise*/
+            m->ec = *(j->ec);
+            market_init(m, j->rq.seed, 0);
+            m->figs = 0;
+            m->indep = 1;
+            if (j->point.n_axes > 0) sweep_point(&(j->point), 0, m);
+            da.job = j;
+            m->day_fn = sv_day;
+            m->day_arg = &da;
+            market_exp(m, e, j->rq.n_exps, r);
+        }
+
+        pthread_mutex_lock(&sv_lock);
+        last = (--(j->left) == 0);
+        pthread_mutex_unlock(&sv_lock);
+        if (last) {
+            sv_reply(&done, SV_DONE, j->rq.tag);
+            sv_send(j->conn, &done, NULL);
+            sv_drop(j->conn);
+            free(j);
+        }
+    }
+    free(m);
+    free(r);
+    return (NULL);
+}
+
+// sv-check: check a request's overrides, setting them up as a sweep of one point; returns a message if they
+// won't do, or NULL
+static char *sv_check(Sv_job *j, char msg[]) {
+    int p, min_trades, max_trades;
+    Sweep *sw = &(j->point);
+    Expctl ec;
+    Zip_params zp = zip_defaults;
+
+    memset(sw, 0, sizeof(Sweep));
+    sw->n_points = 1;
+    for (p = 0; p < SW_N_PARAMS; p++) {
+        if (!(j->rq.set & (1 << p))) continue;
+        if (!isfinite(j->rq.v[p]) || ((j->rq.v[p] < 0.0) && (p != SW_PROFIT_MIN))) {
+            snprintf(msg, SV_MSGLEN, "parameter %d is %g", p, j->rq.v[p]);
+            return (msg);
+        }
+        sw->axis[sw->n_axes].param = p;
+        sw->axis[sw->n_axes].n = 1;
+        sw->axis[sw->n_axes].v[0] = j->rq.v[p];
+        (sw->n_axes)++;
+    }
+    if (j->rq.set & ~((1 << SW_N_PARAMS) - 1)) {
+        snprintf(msg, SV_MSGLEN, "no parameters beyond %d", SW_N_PARAMS - 1);
+        return (msg);
+    }
+
+    /*what sweep_point() would otherwise give up on*/
+    min_trades = (j->rq.set & (1 << SW_MIN_TRADES) ? (int) j->rq.v[SW_MIN_TRADES] : j->ec->min_trades);
+    max_trades = (j->rq.set & (1 << SW_MAX_TRADES) ? (int) j->rq.v[SW_MAX_TRADES] : j->ec->max_trades);
+    if ((min_trades < 1) || (max_trades < min_trades) || (max_trades > MAX_TRADES)) {
+        snprintf(msg, SV_MSGLEN, "min_trades=%d, max_trades=%d (MAX_TRADES=%d)", min_trades, max_trades, MAX_TRADES);
+        return (msg);
+    }
+    if ((j->rq.set & (1 << SW_NYSE)) && (j->rq.v[SW_NYSE] > RULES_BOOK)) {
+        snprintf(msg, SV_MSGLEN, "nyse=%g", j->rq.v[SW_NYSE]);
+        return (msg);
+    }
+    if ((j->rq.set & (1 << SW_RANDOM)) && (j->rq.v[SW_RANDOM] >= MAX_STRAT)) {
+        snprintf(msg, SV_MSGLEN, "random=%g", j->rq.v[SW_RANDOM]);
+        return (msg);
+    }
+    ec = *(j->ec); /*the experiment as the overrides leave it, sharing its schedules*/
+    if (j->rq.set & (1 << SW_NYSE)) ec.nyse = (int) j->rq.v[SW_NYSE];
+    if (j->rq.set & (1 << SW_MARK)) zp.mark = j->rq.v[SW_MARK];
+    if (j->rq.set & (1 << SW_MARK_ABS)) zp.mark_abs = j->rq.v[SW_MARK_ABS];
+    if (j->rq.set & (1 << SW_PROFIT_MIN)) zp.profit_min = j->rq.v[SW_PROFIT_MIN];
+    if (j->rq.set & (1 << SW_PROFIT_RANGE)) zp.profit_range = j->rq.v[SW_PROFIT_RANGE];
+    if (expctl_check(&ec, &zp, (j->rq.set & (1 << SW_RANDOM)) ? (int) j->rq.v[SW_RANDOM] : -1, ec.id, msg,
+                     SV_MSGLEN) != EC_OK)
+        return (msg);
+    return (NULL);
+}
+
+// sv-reader: read a client's requests, and queue them
+static void *sv_reader(void *arg) {
+    Sv_conn *c = arg;
+    Sv_job *j, **pj;
+    char msg[SV_MSGLEN], *bad;
+    long n, got;
+    int i;
+
+    for (;;) {
+        if ((j = malloc(sizeof(Sv_job))) == NULL) break;
+        for (got = 0; got < (long) sizeof(Sv_request); got += n) {
+            n = read(c->fd, ((char *) &(j->rq)) + got, sizeof(Sv_request) - got);
+            if ((n < 0) && (errno == EINTR)) n = 0;
+            else if (n <= 0) break;
+        }
+        if (got < (long) sizeof(Sv_request)) { /*the client has hung up*/
+            free(j);
+            break;
+        }
+        if ((j->rq.magic != SV_MAGIC) || (j->rq.version != SV_VERSION) || (j->rq.kind != SV_RUN)) {
+            sv_error(c, j->rq.tag, "not a version 1 run request");
+            free(j);
+            break; /*out of step with the client, so nothing more it says can be read*/
+        }
+        j->rq.id[MAX_ID - 1] = '\0';
+        j->ec = NULL;
+        for (i = 0; i < sv_n_exps; i++) { if (strcmp(sv_exps[i].id, j->rq.id) == 0) j->ec = sv_exps + i; }
+        bad = NULL;
+        if (j->ec == NULL) bad = "no such experiment";
+        else if (j->rq.n_exps < 1) bad = "no experiments to run";
+        else bad = sv_check(j, msg);
+        if (bad != NULL) {
+            sv_error(c, j->rq.tag, bad);
+            free(j);
+            continue;
+        }
+
+        j->conn = c;
+        j->next = 0;
+        j->left = j->rq.n_exps;
+        j->nxt = NULL;
+        pthread_mutex_lock(&sv_lock);
+        (c->refs)++;
+        for (pj = &sv_head; *pj != NULL; pj = &((*pj)->nxt));
+        *pj = j;
+        pthread_cond_broadcast(&sv_work);
+        pthread_mutex_unlock(&sv_lock);
+    }
+    sv_drop(c);
+    return (NULL);
+}
+
+// sv-quit: stop serving at the next chance
+static void sv_quit_handler(int sig) {
+    sv_quit = 1;
+}
+
+// serve-main: serve the experiments in n_files files on the socket at path, with n_threads threads
+int serve_main(char path[], int n_threads, int n_files, char *files[]) {
+    int i, k, lfd, fd;
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    struct stat st;
+    pthread_t *workers, reader;
+    Sv_conn *c;
+
+    if ((n_threads < 1) || (n_files < 1) || (strlen(path) >= sizeof(addr.sun_path))) {
+        fprintf(stderr, "\nFail: smith serve needs a socket path of under %d characters, threads and datafiles\n",
+                (int) sizeof(addr.sun_path));
+        exit(0);
+    }
+    sv_n_exps = n_files;
+    if ((sv_exps = calloc(n_files, sizeof(Expctl))) == NULL) {
+        fprintf(stderr, "\nFail: can't allocate for %d experiments\n", n_files);
+        exit(0);
+    }
+    for (i = 0; i < n_files; i++) {
+        expctl_in(files[i], sv_exps + i, 0);
+        for (k = 0; k < i; k++) {
+            if (strcmp(sv_exps[k].id, sv_exps[i].id) == 0) {
+                fprintf(stderr, "\nFail: %s and %s are both experiment %s\n", files[k], files[i], sv_exps[i].id);
+                exit(0);
+            }
+        }
+    }
+
+    /*a socket left by a server that has gone is taken over; anything else there isn't touched*/
+    if ((stat(path, &st) == 0) && S_ISSOCK(st.st_mode)) unlink(path);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (((lfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) || (bind(lfd, (struct sockaddr *) &addr, sizeof(addr)) != 0) ||
+        (listen(lfd, 64) != 0)) {
+        fprintf(stderr, "\nFail: can't listen on %s (%s)\n", path, strerror(errno));
+        exit(0);
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sv_quit_handler; /*without SA_RESTART, so that accept() returns*/
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if ((workers = malloc(n_threads * sizeof(pthread_t))) == NULL) {
+        fprintf(stderr, "\nFail: can't allocate for %d threads\n", n_threads);
+        exit(0);
+    }
+    for (i = 0; i < n_threads; i++) pthread_create(workers + i, NULL, sv_worker, NULL);
+    fprintf(stdout, "Serving %d experiments on %s with %d threads\n", n_files, path, n_threads);
+    fflush(stdout);
+
+    while (!sv_quit) {
+        if ((fd = accept(lfd, NULL, NULL)) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "accept: %s\n", strerror(errno));
+            continue;
+        }
+        if ((c = malloc(sizeof(Sv_conn))) == NULL) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->refs = 1;
+        c->dead = 0;
+        pthread_mutex_init(&(c->wlock), NULL);
+        if (pthread_create(&reader, NULL, sv_reader, c) != 0) {
+            sv_drop(c);
+            continue;
+        }
+        pthread_detach(reader);
+    }
+
+    /*let the experiments being run finish, then stop*/
+    close(lfd);
+    unlink(path);
+    pthread_mutex_lock(&sv_lock);
+    sv_stop = 1;
+    pthread_cond_broadcast(&sv_work);
+    pthread_mutex_unlock(&sv_lock);
+    for (i = 0; i < n_threads; i++) pthread_join(workers[i], NULL);
+    fprintf(stdout, "Stopped serving on %s\n", path);
+    free(workers);
+    return (1);
+}
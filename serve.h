@@ -0,0 +1,45 @@
+//
+// serve.h: run experiments for clients of a Unix-domain socket, keeping the experiments loaded and the threads warm
+//
+// "smith serve socket threads datafile..." loads each experiment file (or image) once, names it by its id, and
+// listens on socket. A client writes Sv_requests, each asking for n_exps independent experiments on one of those
+// experiments, experiment e seeded with seed+e as smith -e would, with any of the sweep parameters (SW_... of
+// sweep.h) overridden. Each connection can have any number of requests running at once.
+//
+// The server's threads take experiments from the running requests in turn, one experiment at a time, so a big
+// request doesn't hold up the small ones that come after it. Each day of each experiment is sent back as an
+// SV_DAY Sv_reply as soon as it ends, tagged with the request's tag; the days of different experiments arrive
+// interleaved. An SV_DONE reply follows the request's last day, and SV_ERROR, followed by len bytes of message,
+// answers a request that can't be run. Everything is in the server's own byte order and layout.
+
+#define SV_MAGIC   0x5a495053 /*"ZIPS"*/
+#define SV_VERSION 1
+
+// symbolic constants for the kinds of messages
+#define SV_RUN     1 /*request: run experiments*/
+#define SV_DAY     2 /*reply: one day of one experiment*/
+#define SV_DONE    3 /*reply: all the request's experiments have been run*/
+#define SV_ERROR   4 /*reply: the request can't be run*/
+
+// Sv-request: a request to run experiments
+typedef struct a_sv_request {
+    int magic, version, kind;
+    int tag;                     /*the client's name for the request, echoed in every reply to it*/
+    char id[MAX_ID];             /*which experiment*/
+    int n_exps;
+    int seed;
+    int set;                     /*bit p set => parameter p (SW_... of sweep.h) takes the value v[p]*/
+    Real v[SW_N_PARAMS];
+} Sv_request;
+
+// Sv-reply: a reply to a request
+typedef struct a_sv_reply {
+    int magic, kind;
+    int tag;
+    int exp, day;                /*SV_DAY: which experiment's day*/
+    int len;                     /*SV_ERROR: the length of the message that follows*/
+    int n_trades;                /*SV_DAY: what the day adds to the daily stats, as in Exp_day (market.h)*/
+    Real sum_price, alpha, pdisp, effic, pdiff;
+} Sv_reply;
+
+int serve_main(char [], int, int, char *[]);
@@ -0,0 +1,255 @@
+//
+// shard.c: run a share of a run's experiments in one process, and merge the shares (see shard.h)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "ddat.h"
+#include "tdat.h"
+#include "expctl.h"
+#include "strategy.h"
+#include "book.h"
+#include "market.h"
+#include "pool.h"
+#include "shard.h"
+#include "cache.h"
+#include "prof.h"
+#include "trace.h"
+
+// shard-name: the name of the file holding experiments first..last of run id
+void shard_name(char fname[], char id[], int first, int last) {
+#ifdef AGENT_FLOAT
+    sprintf(fname, "%sshard_%d_%d_f32.dat", id, first, last);
+#else
+    sprintf(fname, "%sshard_%d_%d.dat", id, first, last);
+#endif
+}
+
+// shard-run: run experiments first..last (of n_exps) on a market and write their results to a shard file
+void shard_run(Market *m, int n_exps, int first, int last, char fname[]) {
+    int e;
+    Shard_head h;
+    static Exp_result r;
+    FILE *fp;
+
+    if ((fp = fopen(fname, "wb")) == NULL) {
+        fprintf(stderr, "\nFail: can't open shard file %s\n", fname);
+        exit(0);
+    }
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SHARD_MAGIC, 8);
+    h.real_size = sizeof(Real);
+    h.areal_size = sizeof(Areal);
+    h.max_n_days = MAX_N_DAYS;
+    h.max_trades_b = MAX_TRADES;
+    h.max_strat = MAX_STRAT;
+    strncpy(h.id, m->ec.id, MAX_ID - 1);
+    h.n_exps = n_exps;
+    h.rs = m->rs;
+    h.n_days = m->ec.n_days;
+    h.max_trades = m->ec.max_trades;
+    h.strat_mask = m->ec.strat_mask;
+    h.first = first;
+    h.last = last;
+    h.key = cache_config_key(m);
+    fwrite(&h, sizeof(h), 1, fp);
+
+    for (e = first; e <= last; e++) {
+        market_exp(m, e, n_exps, &r);
+        fwrite(&e, sizeof(int), 1, fp);
+        fwrite(&r, sizeof(r), 1, fp);
+        fprintf(stdout, "experiment %d done\n", e);
+    }
+    if (ferror(fp) || (fclose(fp) != 0)) {
+        fprintf(stderr, "\nFail: couldn't write shard file %s\n", fname);
+        exit(0);
+    }
+}
+
+// shard-open: open a shard file and read and check its header, leaving it at its first experiment
+FILE *shard_open(char fname[], Shard_head *h) {
+    FILE *fp;
+
+    if ((fp = fopen(fname, "rb")) == NULL) {
+        fprintf(stderr, "\nFail: can't open shard file %s\n", fname);
+        exit(0);
+    }
+    if ((fread(h, sizeof(Shard_head), 1, fp) != 1) || (memcmp(h->magic, SHARD_MAGIC, 8) != 0)) {
+        fprintf(stderr, "\nFail: %s isn't a shard file\n", fname);
+        exit(0);
+    }
+    if ((h->real_size != sizeof(Real)) || (h->max_n_days != MAX_N_DAYS) || (h->max_trades_b != MAX_TRADES) ||
+        (h->max_strat != MAX_STRAT)) {
+        fprintf(stderr, "\nFail: %s was written by a build with different Real or array bounds\n", fname);
+        exit(0);
+    }
+    h->id[MAX_ID - 1] = '\0';
+    if ((h->first < 0) || (h->last < h->first) || (h->last >= h->n_exps)) {
+        fprintf(stderr, "\nFail: %s holds experiments %d..%d of %d\n", fname, h->first, h->last, h->n_exps);
+        exit(0);
+    }
+    return (fp);
+}
+
+// shard-next: read the result of experiment e, the next in a shard file
+void shard_next(FILE *fp, char fname[], int e, Exp_result *r) {
+    int ee;
+
+    if ((fread(&ee, sizeof(int), 1, fp) != 1) || (fread(r, sizeof(Exp_result), 1, fp) != 1)) {
+        fprintf(stderr, "\nFail: %s stops before experiment %d: was its run cut short?\n", fname, e);
+        exit(0);
+    }
+    if (ee != e) {
+        fprintf(stderr, "\nFail: %s holds experiment %d where %d should be\n", fname, ee, e);
+        exit(0);
+    }
+}
+
+// Sh-sorting: order shards by their first experiment
+static Shard_head *sh_sorting;
+
+static int sh_first_cmp(const void *x, const void *y) {
+    return (sh_sorting[*(const int *) x].first - sh_sorting[*(const int *) y].first);
+}
+
+// shard-merge: merge n shard files into the graphs of their run
+void shard_merge(int n, char *fnames[]) {
+    int i, k, e, d, t, *order;
+    Shard_head *h;
+    Day_data ddat[MAX_N_DAYS];
+    Real_stat ats_e[MAX_TRADES];
+    static Exp_result r;
+    FILE *fp;
+
+    if (n < 1) {
+        fprintf(stderr, "\nFail: no shards to merge\n");
+        exit(0);
+    }
+    h = malloc(n * sizeof(Shard_head));
+    order = malloc(n * sizeof(int));
+    if ((h == NULL) || (order == NULL)) {
+        fprintf(stderr, "\nFail: can't allocate for %d shards\n", n);
+        exit(0);
+    }
+    for (i = 0; i < n; i++) {
+        fclose(shard_open(fnames[i], h + i));
+        if ((strcmp(h[i].id, h[0].id) != 0) || (h[i].n_exps != h[0].n_exps) || (h[i].rs != h[0].rs) ||
+            (h[i].n_days != h[0].n_days) || (h[i].max_trades != h[0].max_trades) ||
+            (h[i].strat_mask != h[0].strat_mask)) {
+            fprintf(stderr, "\nFail: %s and %s are shards of different runs\n", fnames[0], fnames[i]);
+            exit(0);
+        }
+        if (h[i].key != h[0].key) {
+            fprintf(stderr, "\nFail: %s and %s are shards of runs of %s with different experiment files or "
+                            "parameters\n", fnames[0], fnames[i], h[0].id);
+            exit(0);
+        }
+        if (h[i].areal_size != h[0].areal_size) {
+            fprintf(stderr, "\nFail: %s and %s were written by builds of different precision\n", fnames[0],
+                    fnames[i]);
+            exit(0);
+        }
+        order[i] = i;
+    }
+
+    /*the shards must cover experiments 0..n_exps-1 once each*/
+    sh_sorting = h;
+    qsort(order, n, sizeof(int), sh_first_cmp);
+    e = 0;
+    for (k = 0; k < n; k++) {
+        i = order[k];
+        if (h[i].first > e) {
+            fprintf(stderr, "\nFail: no shard holds experiments %d..%d\n", e, h[i].first - 1);
+            exit(0);
+        }
+        if (h[i].first < e) {
+            fprintf(stderr, "\nFail: %s and %s both hold experiment %d\n", fnames[order[k - 1]], fnames[i],
+                    h[i].first);
+            exit(0);
+        }
+        e = h[i].last + 1;
+    }
+    if (e < h[0].n_exps) {
+        fprintf(stderr, "\nFail: no shard holds experiments %d..%d\n", e, h[0].n_exps - 1);
+        exit(0);
+    }
+
+    /*fold the experiments in order*/
+    for (d = 0; d < h[0].n_days; d++) ddat_init(ddat + d);
+    for (t = 0; t < MAX_TRADES; t++) {
+        ats_e[t].n = 0;
+        ats_e[t].sum = ats_e[t].sumsq = 0.0;
+    }
+    for (k = 0; k < n; k++) {
+        i = order[k];
+        fp = shard_open(fnames[i], h + i);
+        for (e = h[i].first; e <= h[i].last; e++) {
+            shard_next(fp, fnames[i], e, &r);
+            exp_add(&r, ddat, ats_e);
+        }
+        fclose(fp);
+    }
+    fprintf(stdout, "merged %d experiments from %d shards\n", h[0].n_exps, n);
+
+    run_graphs(h[0].id, h[0].n_days, h[0].max_trades, h[0].strat_mask, h[0].n_exps, ddat, ats_e);
+    free(h);
+    free(order);
+}
+
+// shard-coord: run a market's n_exps experiments as n_procs shards, each in its own process with
+// n_threads threads, then merge them
+void shard_coord(Market *m, int n_exps, int n_procs, int n_threads) {
+    int p, first, last, status;
+    pid_t pid;
+    char **fnames;
+
+    if (n_procs > n_exps) n_procs = n_exps;
+    fnames = malloc(n_procs * sizeof(char *));
+    if (fnames == NULL) {
+        fprintf(stderr, "\nFail: can't allocate for %d shards\n", n_procs);
+        exit(0);
+    }
+
+    fflush(stdout); /*or the children would each print it again*/
+    for (p = 0; p < n_procs; p++) {
+        first = (int) (((long) n_exps * p) / n_procs);
+        last = (int) (((long) n_exps * (p + 1)) / n_procs) - 1;
+        fnames[p] = malloc(MAX_ID + 40);
+        shard_name(fnames[p], m->ec.id, first, last);
+
+        pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "\nFail: can't start shard process %d\n", p);
+            exit(0);
+        }
+        if (pid == 0) { /*the child: threads don't survive fork(), so it starts its own*/
+            if (n_threads > 1) pool_start(n_threads);
+            shard_run(m, n_exps, first, last, fnames[p]);
+            cache_report();
+            pool_stop();
+            fnames[p][strlen(fnames[p]) - strlen(".dat")] = '\0'; /*as smith -k would name them*/
+            PROF_REPORT(fnames[p]);
+            TRACE_DUMP(fnames[p]);
+            exit(0);
+        }
+    }
+    fprintf(stdout, "%d shard processes\n", n_procs);
+
+    for (p = 0; p < n_procs; p++) {
+        if ((wait(&status) > 0) && WIFSIGNALED(status)) {
+            fprintf(stderr, "\nFail: a shard process was killed by signal %d\n", WTERMSIG(status));
+            exit(0);
+        }
+    }
+    shard_merge(n_procs, fnames);
+
+    for (p = 0; p < n_procs; p++) free(fnames[p]);
+    free(fnames);
+}
@@ -0,0 +1,39 @@
+//
+// shard.h: run a share of a run's experiments in one process, and merge the shares
+//
+// A shard file holds the exact Exp_result of each experiment in the shard, in experiment order, after
+// a header saying which run it belongs to, down to a hash of its whole configuration, and which build
+// wrote it. Merging reads any number of shards, checks that together they hold every experiment of the
+// run once, and folds the results in experiment order, so the graphs are the same as the unsharded run's
+// whatever order the shards are named in. Only runs whose experiments are independently seeded (smith -e)
+// can be sharded. A build with single-precision traders (smith32) names its shards
+// <id>shard_<first>_<last>_f32.dat, so that they can sit beside the double build's, and shards of the two
+// builds are never merged together.
+
+#define SHARD_MAGIC "ZIPSHRD3"
+
+// Shard-head: what a shard file starts with
+typedef struct a_shard_head {
+    char magic[8];               /*SHARD_MAGIC*/
+    int real_size;               /*the build that wrote it: sizeof(Real) and array bounds*/
+    int areal_size;              /*and sizeof(Areal)*/
+    int max_n_days, max_trades_b, max_strat;
+    char id[MAX_ID];             /*the run: experiment id*/
+    int n_exps;                  /*number of experiments in the whole run*/
+    int rs;                      /*random seed of the whole run*/
+    int n_days, max_trades, strat_mask;
+    int first, last;             /*the shard: experiments first..last*/
+    unsigned long long key;      /*cache_config_key() of the run's market: its whole configuration*/
+} Shard_head;
+
+void shard_name(char [], char [], int first, int last);
+
+void shard_run(Market *, int n_exps, int first, int last, char []);
+
+FILE *shard_open(char [], Shard_head *);
+
+void shard_next(FILE *, char [], int e, Exp_result *);
+
+void shard_merge(int, char *[]);
+
+void shard_coord(Market *, int n_exps, int n_procs, int n_threads);
@@ -0,0 +1,187 @@
+//
+// strategy.c: ZIP, ZI-C and ZI-U traders as tables of batched operations (see strategy.h)
+//
+// ZI-C agents still run the ZIP learning update on margins they never quote from, as smith always
+// has, so a seed produces the same random stream whichever of the two is chosen.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "random.h"
+#include "max.h"
+#include "agent.h"
+#include "strategy.h"
+
+// get-price: get a price from an agent
+Cents get_price(Agent *a, int id, Strategy *st, int verbose) {
+    Cents price;
+
+    price = st->quote(a);
+
+    if (verbose) {
+        if (a->job == BUY)
+            fprintf(stdout, "Buyer %d bids at %5.3f (reward=%5.3f)\n",
+                    id, PRICE(price), reward(a, price));
+        else
+            fprintf(stdout, "Seller %d offers at %5.3f (reward=%5.3f)\n",
+                    id, PRICE(price), reward(a, price));
+    }
+    return (price);
+}
+
+// zip-quote: ZIP agents shout the price set by their profit margin
+static Cents zip_quote(Agent *a) {
+    return (a->price);
+}
+
+// zic-quote: ZI-C agents shout a random price between their limit and the edge of the price range
+static Cents zic_quote(Agent *a) {
+    Real price;
+
+    if (RMAX < PRICE(a->limit)) {
+        fprintf(stderr, "\nFail: rmax too low in get_price()\n");
+        exit(0);
+    }
+
+    if (a->job == BUY) price = RMIN + randval_c(RS_QUOTE, PRICE(a->limit) - RMIN);
+    else price = PRICE(a->limit) + randval_c(RS_QUOTE, RMAX - PRICE(a->limit));
+    a->price = CENTS(price);
+    return (a->price);
+}
+
+// ziu-quote: ZI-U agents shout a random price anywhere in the price range, ignoring their limit
+static Cents ziu_quote(Agent *a) {
+    a->price = CENTS(RMIN + randval_c(RS_QUOTE, RMAX - RMIN));
+    return (a->price);
+}
+
+// zip-willing: a ZIP agent is willing if its current price would take the shout
+static int zip_willing(int job, Cents price, Agent agents[], int n, int base,
+                       int ilist[], int n_list, char *s, int verbose) {
+    int a;
+
+    for (a = 0; a < n; a++) {
+        willing_trade(agents + a, price);
+        if (agents[a].willing) {
+            ilist[n_list++] = base + a;
+            if (verbose) {
+                fprintf(stdout, "%s%2d willing (r)price=%5.3f reward=%5.3f\n",
+                        s, base + a, PRICE(price), reward(agents + a, price));
+            }
+        }
+    }
+    return (n_list);
+}
+
+// random-willing: a random agent generates a price and is willing if that price would take the shout
+ALWAYS_INLINE int random_willing(Cents (*quote)(Agent *), int job, Cents price, Agent agents[], int n,
+                                 int base, int ilist[], int n_list, char *s, int verbose) {
+    int a;
+    Cents r_price, p;
+
+    p = price;
+    for (a = 0; a < n; a++) {
+        agents[a].willing = 0;
+
+        if (agents[a].active) {
+            r_price = quote(agents + a);
+            if (verbose) {
+                fprintf(stdout, "%s %d %s at %5.3f (reward=%5.3f)\n", job == BUY ? "Buyer" : "Seller",
+                        base + a, job == BUY ? "bids" : "offers", PRICE(r_price), reward(agents + a, r_price));
+            }
+            if (job == BUY) {
+                if (r_price > price) {
+                    agents[a].willing = 1;
+                    p = r_price;
+                }
+            } else {
+                if (r_price < price) {
+                    agents[a].willing = 1;
+                    p = r_price;
+                }
+            }
+        }
+
+        if (agents[a].willing) {
+            ilist[n_list++] = base + a;
+            if (verbose) {
+                fprintf(stdout, "%s%2d willing (r)price=%5.3f reward=%5.3f\n",
+                        s, base + a, PRICE(p), reward(agents + a, price));
+            }
+        }
+    }
+    return (n_list);
+}
+
+// zic-willing: random willingness with ZI-C quotes
+static int zic_willing(int job, Cents price, Agent agents[], int n, int base,
+                       int ilist[], int n_list, char *s, int verbose) {
+    return (random_willing(zic_quote, job, price, agents, n, base, ilist, n_list, s, verbose));
+}
+
+// ziu-willing: random willingness with ZI-U quotes
+static int ziu_willing(int job, Cents price, Agent agents[], int n, int base,
+                       int ilist[], int n_list, char *s, int verbose) {
+    return (random_willing(ziu_quote, job, price, agents, n, base, ilist, n_list, s, verbose));
+}
+
+// zip-nyse-bar: a ZIP agent whose price doesn't beat the best shout can't shout
+static void zip_nyse_bar(int job, Agent agents[], int n, Cents best) {
+    int a;
+
+    if (job == SELL) { /*any seller with an equal or higher price can't offer*/
+        for (a = 0; a < n; a++) { if (agents[a].price >= best) agents[a].able = 0; }
+    } else { /*any buyer with an equal or lower price can't bid*/
+        for (a = 0; a < n; a++) { if (agents[a].price <= best) agents[a].able = 0; }
+    }
+}
+
+// zic-nyse-bar: a ZI-C agent whose limit rules out beating the best shout can't shout
+static void zic_nyse_bar(int job, Agent agents[], int n, Cents best) {
+    int a;
+
+    if (job == SELL) { /*any seller with a limit price higher than best offer can't deal*/
+        for (a = 0; a < n; a++) { if (agents[a].limit > best) agents[a].able = 0; }
+    } else { /*any buyer with limit lower than best bid can't deal*/
+        for (a = 0; a < n; a++) { if (agents[a].limit < best) agents[a].able = 0; }
+    }
+}
+
+// ziu-nyse-bar: a ZI-U agent is unconstrained, so can always beat the best shout
+static void ziu_nyse_bar(int job, Agent agents[], int n, Cents best) {
+}
+
+// ziu-update: ZI-U agents don't learn
+static void ziu_update(int job, int deal_type, int status, Agent agents[], int n, int base, Cents price,
+                       int verbose) {
+}
+
+Strategy strategies[MAX_STRAT] = {
+        {"ZIP",  zip_quote, zip_willing, zip_nyse_bar, zip_update},
+        {"ZI-C", zic_quote, zic_willing, zic_nyse_bar, zip_update},
+        {"ZI-U", ziu_quote, ziu_willing, ziu_nyse_bar, ziu_update}
+};
+
+// strategy-lookup: index of the strategy with a given name, ignoring case and dashes (so "zic" is
+// ZI-C); -1 if there's no such strategy
+int strategy_lookup(char *name) {
+    int st;
+    char *p, *q;
+
+    for (st = 0; st < MAX_STRAT; st++) {
+        p = name;
+        q = strategies[st].name;
+        while ((*p != '\0') || (*q != '\0')) {
+            if (*p == '-') p++;
+            else if (*q == '-') q++;
+            else if (tolower(*p) != tolower(*q)) break;
+            else {
+                p++;
+                q++;
+            }
+        }
+        if ((*p == '\0') && (*q == '\0')) return (st);
+    }
+    return (-1);
+}
@@ -0,0 +1,48 @@
+//
+// strategy.h: trader strategies as tables of batched operations
+//
+// Every operation works on a contiguous batch of agents from one side of the market (job), so the
+// auction makes one indirect call per batch and each strategy's loop over its agents is its own
+// straight-line code. Adding a strategy means writing its operations in strategy.c and giving it an
+// entry in strategies[]; nothing in the auction loop changes.
+
+// symbolic constants for the strategies: also the values of the random flag in an experiment file
+#define ST_ZIP 0   /*Zero-Intelligence Plus: adaptive profit margins*/
+#define ST_ZIC 1   /*Zero-Intelligence Constrained: random quotes that never make a loss*/
+#define ST_ZIU 2   /*Zero-Intelligence Unconstrained: random quotes over the whole price range*/
+
+#define RMIN 0.01 /*bounds on random prices*/
+#define RMAX 4.0
+
+// force a function into its callers, so that constant arguments fold away
+#ifdef __GNUC__
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE static inline
+#endif
+
+// Strategy: the operations of one kind of trader
+typedef struct a_strategy {
+    char *name;
+
+    /*price of one agent's shout*/
+    Cents (*quote)(Agent *a);
+
+    /*append to ilist[] (holding n_list entries) the index base+i of every agent in the batch willing
+      to take a shout at price; returns the new length of ilist[]*/
+    int (*willing)(int job, Cents price, Agent agents[], int n, int base,
+                   int ilist[], int n_list, char *s, int verbose);
+
+    /*NYSE rules: clear the able flag of every agent that can't improve on the best shout so far*/
+    void (*nyse_bar)(int job, Agent agents[], int n, Cents best);
+
+    /*learning update after a shout*/
+    void (*update)(int job, int deal_type, int status, Agent agents[], int n, int base, Cents price,
+                   int verbose);
+} Strategy;
+
+extern Strategy strategies[MAX_STRAT];
+
+Cents get_price(Agent *a, int id, Strategy *st, int verbose);
+
+int strategy_lookup(char *name);
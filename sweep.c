@@ -0,0 +1,317 @@
+//
+// sweep.c: run one experiment file at many points in parameter space (see sweep.h)
+//
+// The experiment file is read once. The points are run as a batch (batch.h), each thread running its
+// jobs on its own Market and seeding experiment e with seed+e at every point, so that points are compared
+// on the same random streams. A point's experiments are folded into its stats in experiment order once
+// the last of them is done, so the table doesn't depend on the number of threads or on which thread ran
+// what.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "max.h"
+#include "random.h"
+#include "agent.h"
+#include "ddat.h"
+#include "tdat.h"
+#include "expctl.h"
+#include "strategy.h"
+#include "book.h"
+#include "market.h"
+#include "pool.h"
+#include "batch.h"
+#include "sweep.h"
+
+#define SW_LINE 1024 /*longest line in a sweep file*/
+
+static char *sw_names[SW_N_PARAMS] = {
+        "mark", "mark_abs", "profit_min", "profit_range", "beta_min", "beta_range", "mom_range",
+        "min_trades", "max_trades", "nyse", "random"
+};
+
+// Sw-row: the summary of one point: the last day's stats over the point's experiments
+typedef struct sw_row {
+    Real v[SW_N_PARAMS];     /*the point's parameter values*/
+    Day_data last;
+} Sw_row;
+
+// Sw-run: a sweep in progress, shared by the threads running its jobs
+typedef struct sw_run {
+    Sweep *sw;
+    Market *base;            /*the experiment as read from its file*/
+    int n_exps;
+    Sw_row *rows;
+} Sw_run;
+
+static _Thread_local Market *sw_market = NULL; /*each thread's market*/
+static _Thread_local SD_sched *sw_sched = NULL; /*each thread's own schedules, for points that change them*/
+
+// sweep-read: read a sweep file
+void sweep_read(char filename[], Sweep *sw) {
+    FILE *fp;
+    char line[SW_LINE], *tok;
+    int p, first = 1;
+    Sweep_axis *ax;
+
+    if ((fp = fopen(filename, "r")) == NULL) {
+        fprintf(stderr, "\nFail: can't open sweep file %s\n", filename);
+        exit(0);
+    }
+
+    sw->list = 0;
+    sw->n_axes = 0;
+    while (fgets(line, SW_LINE, fp) != NULL) {
+        if ((tok = strtok(line, " \t\r\n")) == NULL) continue;
+        if (tok[0] == '#') continue;
+        if (first && (!strcmp(tok, "list"))) {
+            sw->list = 1;
+            first = 0;
+            continue;
+        }
+        first = 0;
+
+        for (p = 0; p < SW_N_PARAMS; p++) { if (!strcmp(tok, sw_names[p])) break; }
+        if (p == SW_N_PARAMS) {
+            fprintf(stderr, "\nFail: no such sweep parameter as %s\n", tok);
+            exit(0);
+        }
+        ax = sw->axis + sw->n_axes;
+        ax->param = p;
+        ax->n = 0;
+        while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+            if (tok[0] == '#') break;
+            if (ax->n == SW_MAX_VALUES) {
+                fprintf(stderr, "\nFail: more than %d values of %s\n", SW_MAX_VALUES, sw_names[p]);
+                exit(0);
+            }
+            if (sscanf(tok, "%lf", ax->v + ax->n) != 1) {
+                fprintf(stderr, "\nFail: bad value %s for %s\n", tok, sw_names[p]);
+                exit(0);
+            }
+            (ax->n)++;
+        }
+        if (ax->n == 0) {
+            fprintf(stderr, "\nFail: no values for %s\n", sw_names[p]);
+            exit(0);
+        }
+        (sw->n_axes)++;
+    }
+    fclose(fp);
+
+    if (sw->n_axes == 0) {
+        fprintf(stderr, "\nFail: nothing to sweep in %s\n", filename);
+        exit(0);
+    }
+    if (sw->list) {
+        sw->n_points = sw->axis[0].n;
+        for (p = 1; p < sw->n_axes; p++) {
+            if (sw->axis[p].n != sw->n_points) {
+                fprintf(stderr, "\nFail: %s has %d values, but list sweeps need %d for every parameter\n",
+                        sw_names[sw->axis[p].param], sw->axis[p].n, sw->n_points);
+                exit(0);
+            }
+        }
+    } else {
+        sw->n_points = 1;
+        for (p = 0; p < sw->n_axes; p++) sw->n_points *= sw->axis[p].n;
+    }
+}
+
+// sw-value: the value of axis a at point p: the first axis varies slowest
+static Real sw_value(Sweep *sw, int p, int a) {
+    int k, i;
+
+    if (sw->list) return (sw->axis[a].v[p]);
+    for (k = sw->n_axes - 1; k > a; k--) p /= sw->axis[k].n;
+    i = p % sw->axis[a].n;
+    return (sw->axis[a].v[i]);
+}
+
+// sw-own: give a market its own copy of its schedules, which it otherwise shares with the rest of the sweep
+static void sw_own(Expctl *ec) {
+    if (sw_sched == NULL) {
+        if ((sw_sched = malloc(2 * MAX_SCHED * sizeof(SD_sched))) == NULL) {
+            fprintf(stderr, "\nFail: can't allocate schedules for a sweep thread\n");
+            exit(0);
+        }
+    }
+    memcpy(sw_sched, ec->dem_sched, ec->n_dem_sched * sizeof(SD_sched));
+    memcpy(sw_sched + MAX_SCHED, ec->sup_sched, ec->n_sup_sched * sizeof(SD_sched));
+    ec->dem_sched = sw_sched;
+    ec->sup_sched = sw_sched + MAX_SCHED;
+}
+
+// sw-strategy: give every agent of a schedule the same strategy
+static void sw_strategy(SD_sched *sched, int st) {
+    int a;
+
+    for (a = 0; a < sched->n_agents; a++) sched->agents[a].strategy = st;
+    if (partition_sched(sched) != EC_OK) {
+        fprintf(stderr, "\nFail: out of memory regrouping a sweep point's agents\n");
+        exit(0);
+    }
+}
+
+// sweep-point: set a market up at point p of a sweep
+void sweep_point(Sweep *sw, int p, Market *m) {
+    int a, s;
+    Real v;
+    char name[40], err[256];
+    Expctl *ec = &(m->ec);
+
+    for (a = 0; a < sw->n_axes; a++) {
+        v = sw_value(sw, p, a);
+        switch (sw->axis[a].param) {
+            case SW_MARK: m->zp.mark = v; break;
+            case SW_MARK_ABS: m->zp.mark_abs = v; break;
+            case SW_PROFIT_MIN: m->zp.profit_min = v; break;
+            case SW_PROFIT_RANGE: m->zp.profit_range = v; break;
+            case SW_BETA_MIN: m->zp.beta_min = v; break;
+            case SW_BETA_RANGE: m->zp.beta_range = v; break;
+            case SW_MOM_RANGE: m->zp.mom_range = v; break;
+            case SW_MIN_TRADES: ec->min_trades = (int) v; break;
+            case SW_MAX_TRADES: ec->max_trades = (int) v; break;
+            case SW_NYSE:
+                ec->nyse = (int) v;
+                if ((ec->nyse < RULES_PLAIN) || (ec->nyse > RULES_BOOK)) {
+                    fprintf(stderr, "\nFail: nyse=%d in sweep\n", ec->nyse);
+                    exit(0);
+                }
+                break;
+            case SW_RANDOM:
+                ec->random = (int) v;
+                if ((ec->random < 0) || (ec->random >= MAX_STRAT)) {
+                    fprintf(stderr, "\nFail: random=%d in sweep\n", ec->random);
+                    exit(0);
+                }
+                sw_own(ec);
+                for (s = 0; s < ec->n_dem_sched; s++) sw_strategy(ec->dem_sched + s, ec->random);
+                for (s = 0; s < ec->n_sup_sched; s++) sw_strategy(ec->sup_sched + s, ec->random);
+                ec->strat_mask = (1 << ec->random);
+                break;
+        }
+    }
+    if ((ec->min_trades < 1) || (ec->max_trades < ec->min_trades) || (ec->max_trades > MAX_TRADES)) {
+        fprintf(stderr, "\nFail: min_trades=%d, max_trades=%d in sweep (MAX_TRADES=%d)\n",
+                ec->min_trades, ec->max_trades, MAX_TRADES);
+        exit(0);
+    }
+    sprintf(name, "sweep point %d", p);
+    if (expctl_check(ec, &(m->zp), -1, name, err, sizeof(err)) != EC_OK) { /*with the agents as the point has them*/
+        fprintf(stderr, "\nFail: %s\n", err);
+        exit(0);
+    }
+    m->trade = trade_select(ec);
+}
+
+// sw-params: every parameter's value for a market
+static void sw_params(Market *m, Real v[]) {
+    v[SW_MARK] = m->zp.mark;
+    v[SW_MARK_ABS] = m->zp.mark_abs;
+    v[SW_PROFIT_MIN] = m->zp.profit_min;
+    v[SW_PROFIT_RANGE] = m->zp.profit_range;
+    v[SW_BETA_MIN] = m->zp.beta_min;
+    v[SW_BETA_RANGE] = m->zp.beta_range;
+    v[SW_MOM_RANGE] = m->zp.mom_range;
+    v[SW_MIN_TRADES] = m->ec.min_trades;
+    v[SW_MAX_TRADES] = m->ec.max_trades;
+    v[SW_NYSE] = m->ec.nyse;
+    v[SW_RANDOM] = m->ec.random;
+}
+
+// sw-fold: fold the finished experiments of point p, run on market m, into its row, in experiment order
+static void sw_fold(void *arg, int p, Market *m, Exp_result res[]) {
+    Sw_run *run = arg;
+    int d, e, t, n_days = run->base->ec.n_days;
+    Day_data dd[MAX_N_DAYS];
+    Real_stat ats_e[MAX_TRADES];
+
+    for (d = 0; d < n_days; d++) ddat_init(dd + d);
+    for (t = 0; t < MAX_TRADES; t++) {
+        ats_e[t].n = 0;
+        ats_e[t].sum = ats_e[t].sumsq = 0.0;
+    }
+    for (e = 0; e < run->n_exps; e++) exp_add(res + e, dd, ats_e);
+    run->rows[p].last = dd[n_days - 1];
+    sw_params(m, run->rows[p].v);
+    fprintf(stdout, "point %d done\n", p);
+}
+
+// sw-setup: set this thread's market up at point p
+static Market *sw_setup(void *arg, int p) {
+    Sw_run *run = arg;
+    Market *m;
+
+    if (sw_market == NULL) {
+        if ((sw_market = malloc(sizeof(Market))) == NULL) {
+            fprintf(stderr, "\nFail: can't allocate a market for a sweep thread\n");
+            exit(0);
+        }
+    }
+    m = sw_market;
+    m->ec = run->base->ec;
+    market_init(m, run->base->rs, 0);
+    m->figs = 0;
+    m->indep = 1;
+    m->warm = run->base->warm;
+    m->jitter = run->base->jitter;
+    m->crn = run->base->crn;
+    m->anti = run->base->anti;
+    sweep_point(run->sw, p, m);
+    return (m);
+}
+
+// sweep-run: run n_exps experiments of the market base at every point of a sweep, shared out over the
+// thread pool, and write one row per point to the table fname
+void sweep_run(Sweep *sw, Market *base, int n_exps, char fname[]) {
+    Sw_run run;
+    int p, k, agents;
+    long max_trades, *cost;
+    FILE *fp;
+
+    run.sw = sw;
+    run.base = base;
+    run.n_exps = n_exps;
+    cost = malloc(sw->n_points * sizeof(long));
+    run.rows = malloc(sw->n_points * sizeof(Sw_row));
+    if ((cost == NULL) || (run.rows == NULL)) {
+        fprintf(stderr, "\nFail: can't allocate a sweep of %d points\n", sw->n_points);
+        exit(0);
+    }
+
+    /*a point costs about (trades a day) x (agents) x (days)*/
+    agents = base->ec.dem_sched[0].n_agents + base->ec.sup_sched[0].n_agents;
+    for (p = 0; p < sw->n_points; p++) {
+        max_trades = base->ec.max_trades;
+        for (k = 0; k < sw->n_axes; k++) { if (sw->axis[k].param == SW_MAX_TRADES) max_trades = sw_value(sw, p, k); }
+        cost[p] = max_trades * agents * base->ec.n_days;
+        sw_setup(&run, p); /*a point that can't run stops the sweep before any does*/
+    }
+
+    fprintf(stdout, "%d points x %d experiments on %d threads\n", sw->n_points, n_exps, pool_size());
+    batch_run(sw->n_points, n_exps, cost, sw_setup, sw_fold, &run);
+
+    fp = fopen(fname, "w");
+    fprintf(fp, "# point");
+    for (k = 0; k < SW_N_PARAMS; k++) fprintf(fp, " %s", sw_names[k]);
+    fprintf(fp, " n_exps effic effic_sd alpha alpha_sd pdisp pdisp_sd quant quant_sd price price_sd"
+                "   (last day: mean and s.d. over experiments)\n");
+    for (p = 0; p < sw->n_points; p++) {
+        fprintf(fp, "%d", p);
+        for (k = 0; k < SW_N_PARAMS; k++) fprintf(fp, " %g", run.rows[p].v[k]);
+        fprintf(fp, " %d", n_exps);
+        rstat_msd(fp, &(run.rows[p].last.effic));
+        rstat_msd(fp, &(run.rows[p].last.alpha));
+        rstat_msd(fp, &(run.rows[p].last.pdisp));
+        rstat_msd(fp, &(run.rows[p].last.quant));
+        rstat_msd(fp, &(run.rows[p].last.price));
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+
+    free(cost);
+    free(run.rows);
+}
@@ -0,0 +1,47 @@
+//
+// sweep.h: run one experiment file at many points in parameter space
+//
+// A sweep file names the parameters to vary, one per line, each followed by its values:
+//   # parameter  values...
+//   mark        0.02 0.05 0.1
+//   nyse        0 1 2 3
+// The points are every combination of the values (a grid), or, if the first line is the word "list",
+// the first values of every parameter, then the second values, and so on. Any parameter not named
+// keeps the value from the experiment file, or the default learning parameter.
+
+#define SW_MAX_VALUES 64 /*most values one parameter can take in a sweep*/
+
+// symbolic constants for the parameters a sweep can vary
+#define SW_MARK         0  /*maximum relative perturbation of a target price*/
+#define SW_MARK_ABS     1  /*maximum absolute perturbation of a target price*/
+#define SW_PROFIT_MIN   2  /*initial profit margins*/
+#define SW_PROFIT_RANGE 3
+#define SW_BETA_MIN     4  /*learning rates*/
+#define SW_BETA_RANGE   5
+#define SW_MOM_RANGE    6  /*momentum*/
+#define SW_MIN_TRADES   7  /*market settings from the experiment file*/
+#define SW_MAX_TRADES   8
+#define SW_NYSE         9
+#define SW_RANDOM       10
+#define SW_N_PARAMS     11
+
+// Sweep-axis: one parameter of a sweep and the values it takes
+typedef struct a_sweep_axis {
+    int param;               /*which parameter: SW_...*/
+    int n;                   /*number of values*/
+    Real v[SW_MAX_VALUES];
+} Sweep_axis;
+
+// Sweep: the parameters a sweep varies, and how they combine into points
+typedef struct a_sweep {
+    int list;                /*boolean: points are the axes' values taken in step, rather than a grid?*/
+    int n_axes;
+    Sweep_axis axis[SW_N_PARAMS];
+    int n_points;
+} Sweep;
+
+void sweep_read(char [], Sweep *);
+
+void sweep_point(Sweep *, int, Market *);
+
+void sweep_run(Sweep *, Market *, int, char []);
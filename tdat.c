@@ -33,7 +33,7 @@ void xg_trades_graph(Trade_data tdat[MAX_N_DAYS][MAX_TRADES],
     { gx=d+1;
         q=(ddat+d)->quant.sum;
         for(t=0;t<q;t++)
-        { if(tdat[d][t].deal_p>=0.0) fprintf(fp,"%f %f\n",gx,tdat[d][t].deal_p);
+        { if(tdat[d][t].deal_p>=0) fprintf(fp,"%f %f\n",gx,PRICE(tdat[d][t].deal_p));
             gx+=dgx;
         }
     }
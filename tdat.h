@@ -5,7 +5,7 @@
 //
 
 typedef struct trade_data {
-    Real deal_p; /*price at which deal succeeds*/
+    Cents deal_p; /*price at which deal succeeds*/
     int deal_t;  /*type of deal accepted (bid or ask)*/
     Real t_eq_p; /*theoretical equilibrium price*/
     int t_eq_q;  /*theoretical equilibrium quantity*/
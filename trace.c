@@ -0,0 +1,151 @@
+//
+// trace.c: per-thread span buffers and Chrome trace-event JSON output (see trace.h)
+//
+// A thread's first event allocates its buffer and pushes it onto a global list with a
+// compare-and-swap, so no thread ever waits on another. Events go into fixed-size chunks that are
+// chained as they fill. trace_dump() must only be called once the other threads have finished.
+
+#ifdef TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#include "trace.h"
+
+#define TR_CHUNK 4096 /*events per buffer chunk*/
+
+// Tr-event: one begin or end mark
+typedef struct tr_event {
+    const char *name; /*span name: must be a string constant*/
+    long long ns;     /*monotonic clock time*/
+    int arg;          /*experiment/day/trade number; <0 => none*/
+    char ph;          /*'B'egin or 'E'nd*/
+} Tr_event;
+
+// Tr-chunk: a block of events
+typedef struct tr_chunk {
+    Tr_event ev[TR_CHUNK];
+    int n;
+    struct tr_chunk *next;
+} Tr_chunk;
+
+// Tr-buf: all the events recorded by one thread
+typedef struct tr_buf {
+    int tid;
+    Tr_chunk *first, *last;
+    struct tr_buf *next;
+} Tr_buf;
+
+static _Atomic(Tr_buf *) tr_bufs = NULL;
+static atomic_int tr_n_threads = 0;
+static _Thread_local Tr_buf *tr_mine = NULL;
+
+// tr-now: monotonic clock in nanoseconds
+static long long tr_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (((long long) ts.tv_sec) * 1000000000LL + ts.tv_nsec);
+}
+
+// tr-chunk-new: allocate an empty chunk
+static Tr_chunk *tr_chunk_new(void) {
+    Tr_chunk *c;
+
+    c = (Tr_chunk *) malloc(sizeof(Tr_chunk));
+    if (c == NULL) {
+        fprintf(stderr, "\nFail: out of memory in trace.c\n");
+        exit(0);
+    }
+    c->n = 0;
+    c->next = NULL;
+    return (c);
+}
+
+// tr-buf-get: this thread's buffer, registering it on first use
+static Tr_buf *tr_buf_get(void) {
+    Tr_buf *b;
+
+    if (tr_mine != NULL) return (tr_mine);
+
+    b = (Tr_buf *) malloc(sizeof(Tr_buf));
+    if (b == NULL) {
+        fprintf(stderr, "\nFail: out of memory in trace.c\n");
+        exit(0);
+    }
+    b->tid = atomic_fetch_add(&tr_n_threads, 1) + 1;
+    b->first = b->last = tr_chunk_new();
+    b->next = atomic_load(&tr_bufs);
+    while (!atomic_compare_exchange_weak(&tr_bufs, &(b->next), b));
+    tr_mine = b;
+    return (b);
+}
+
+// tr-add: append one event to this thread's buffer
+static void tr_add(const char *name, int arg, char ph) {
+    Tr_buf *b = tr_buf_get();
+    Tr_event *e;
+
+    if (b->last->n == TR_CHUNK) {
+        b->last->next = tr_chunk_new();
+        b->last = b->last->next;
+    }
+    e = b->last->ev + (b->last->n)++;
+    e->name = name;
+    e->arg = arg;
+    e->ph = ph;
+    e->ns = tr_now();
+}
+
+// trace-begin: open a span
+void trace_begin(const char *name, int arg) {
+    tr_add(name, arg, 'B');
+}
+
+// trace-end: close the innermost open span of this name
+void trace_end(const char *name) {
+    tr_add(name, -1, 'E');
+}
+
+// trace-dump: write all recorded spans to <id>trace.json
+void trace_dump(char id[]) {
+    Tr_buf *b;
+    Tr_chunk *c;
+    Tr_event *e;
+    long long t0 = -1;
+    int i, first = 1;
+    char fname[FILENAME_MAX];
+    FILE *fp;
+
+    /*timestamps are written relative to the earliest event*/
+    for (b = atomic_load(&tr_bufs); b != NULL; b = b->next) {
+        if ((b->first->n > 0) && ((t0 < 0) || (b->first->ev[0].ns < t0))) t0 = b->first->ev[0].ns;
+    }
+
+    sprintf(fname, "%strace.json", id);
+    fp = fopen(fname, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "\nFail: can't write %s\n", fname);
+        return;
+    }
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (b = atomic_load(&tr_bufs); b != NULL; b = b->next) {
+        for (c = b->first; c != NULL; c = c->next) {
+            for (i = 0; i < c->n; i++) {
+                e = c->ev + i;
+                fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+                        first ? "" : ",\n", e->name, e->ph, (e->ns - t0) / 1000.0, b->tid);
+                if (e->arg >= 0) fprintf(fp, ",\"args\":{\"n\":%d}", e->arg);
+                fprintf(fp, "}");
+                first = 0;
+            }
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    fprintf(stdout, "Timeline written to %s\n", fname);
+}
+
+#endif
@@ -0,0 +1,24 @@
+//
+// trace.h: timeline of experiment, day, trade and output spans in Chrome trace-event format
+//
+// Compiled away unless built with -DTRACE (make TRACE=1). Each thread appends to its own buffer, so
+// recording a span takes no locks; trace_dump() writes every thread's events to <id>trace.json,
+// which loads into chrome://tracing or ui.perfetto.dev.
+
+#ifdef TRACE
+
+void trace_begin(const char *, int);
+void trace_end(const char *);
+void trace_dump(char []);
+
+#define TRACE_BEGIN(name, arg) trace_begin(name, arg)
+#define TRACE_END(name) trace_end(name)
+#define TRACE_DUMP(id) trace_dump(id)
+
+#else
+
+#define TRACE_BEGIN(name, arg)
+#define TRACE_END(name)
+#define TRACE_DUMP(id)
+
+#endif
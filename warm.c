@@ -0,0 +1,104 @@
+//
+// warm.c: save the ZIP traders' learned state, and start later experiments from it (see warm.h)
+//
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "random.h"
+#include "max.h"
+#include "agent.h"
+#include "warm.h"
+
+// warm-name: the name of run id's warm file
+void warm_name(char fname[], char id[]) {
+    sprintf(fname, "%swarm.dat", id);
+}
+
+// warm-save: save the state of n_buy buyers and n_sell sellers at the end of day d to a warm file
+void warm_save(char fname[], Agent buyers[], int n_buy, Agent sellers[], int n_sell, int d) {
+    Warm w;
+    Warm_agent wa;
+    Agent *a;
+    int i;
+    FILE *fp;
+
+    if ((fp = fopen(fname, "wb")) == NULL) {
+        fprintf(stderr, "\nFail: can't open warm file %s\n", fname);
+        exit(0);
+    }
+    memset(&w, 0, sizeof(w));
+    memcpy(w.magic, WARM_MAGIC, 8);
+    w.real_size = sizeof(Real);
+    w.n_buy = n_buy;
+    w.n_sell = n_sell;
+    w.day = d;
+    fwrite(&w, offsetof(Warm, buyers), 1, fp);
+    for (i = 0; i < n_buy + n_sell; i++) {
+        a = (i < n_buy ? buyers + i : sellers + (i - n_buy));
+        wa.profit = a->profit;
+        wa.beta = a->beta;
+        wa.momntm = a->momntm;
+        wa.last_d = a->last_d;
+        fwrite(&wa, sizeof(wa), 1, fp);
+    }
+    if (ferror(fp) || (fclose(fp) != 0)) {
+        fprintf(stderr, "\nFail: couldn't write warm file %s\n", fname);
+        exit(0);
+    }
+}
+
+// warm-read: read a warm file
+void warm_read(char fname[], Warm *w) {
+    FILE *fp;
+
+    if ((fp = fopen(fname, "rb")) == NULL) {
+        fprintf(stderr, "\nFail: can't open warm file %s\n", fname);
+        exit(0);
+    }
+    if ((fread(w, offsetof(Warm, buyers), 1, fp) != 1) || (memcmp(w->magic, WARM_MAGIC, 8) != 0) ||
+        (w->real_size != sizeof(Real))) {
+        fprintf(stderr, "\nFail: %s isn't a warm file from this build\n", fname);
+        exit(0);
+    }
+    if ((w->n_buy < 0) || (w->n_buy > MAX_AGENTS) || (w->n_sell < 0) || (w->n_sell > MAX_AGENTS)) {
+        fprintf(stderr, "\nFail: %s has %d buyers and %d sellers (MAX_AGENTS=%d)\n", fname, w->n_buy,
+                w->n_sell, MAX_AGENTS);
+        exit(0);
+    }
+    w->buyers = malloc((w->n_buy + w->n_sell) * sizeof(Warm_agent));
+    if (w->buyers == NULL) {
+        fprintf(stderr, "\nFail: can't allocate for warm file %s\n", fname);
+        exit(0);
+    }
+    w->sellers = w->buyers + w->n_buy;
+    if (fread(w->buyers, sizeof(Warm_agent), w->n_buy + w->n_sell, fp) != (size_t) (w->n_buy + w->n_sell)) {
+        fprintf(stderr, "\nFail: %s is cut short\n", fname);
+        exit(0);
+    }
+    fclose(fp);
+}
+
+// wm-set: give an agent its saved state, jittering its margin but keeping it on the right side of zero
+static void wm_set(Agent *a, Warm_agent *wa, Real jitter) {
+    a->profit = wa->profit;
+    a->beta = wa->beta;
+    a->momntm = wa->momntm;
+    a->last_d = wa->last_d;
+    if (jitter > 0.0) {
+        a->profit *= (1.0 - jitter) + randval_c(RS_INIT, 2.0 * jitter);
+        if ((a->job == SELL) && (a->profit < 0.0)) a->profit = 0.0;
+        if ((a->job == BUY) && (a->profit > 0.0)) a->profit = 0.0;
+        if (a->profit < -1.0) a->profit = -1.0;
+    }
+}
+
+// warm-apply: give freshly initialised buyers and sellers the state saved in a warm file, with jitter
+void warm_apply(Warm *w, Agent buyers[], Agent sellers[], Real jitter) {
+    int i;
+
+    for (i = 0; i < w->n_buy; i++) wm_set(buyers + i, w->buyers + i, jitter);
+    for (i = 0; i < w->n_sell; i++) wm_set(sellers + i, w->sellers + i, jitter);
+}
@@ -0,0 +1,32 @@
+//
+// warm.h: save the ZIP traders' learned state, and start later experiments from it
+//
+// A warm file holds each buyer's and seller's profit margin, learning rate, momentum and last change
+// as they stood at the end of one day of the first experiment. A run started from it gives every
+// experiment's traders that state in place of buy_init() and sell_init()'s random margins, each margin
+// optionally scaled by a random factor in [1-jitter, 1+jitter], so studies of what happens after a
+// shock needn't spend their first days relearning margins that have been seen to converge before.
+
+#define WARM_MAGIC "ZIPWARM1"
+
+// Warm-agent: what is saved of one trader
+typedef struct a_warm_agent {
+    Real profit, beta, momntm, last_d;
+} Warm_agent;
+
+// Warm: a warm file
+typedef struct a_warm {
+    char magic[8];               /*WARM_MAGIC*/
+    int real_size;               /*sizeof(Real) in the build that wrote it*/
+    int n_buy, n_sell;
+    int day;                     /*the day whose end it was saved at*/
+    Warm_agent *buyers, *sellers;
+} Warm;
+
+void warm_name(char [], char []);
+
+void warm_save(char [], Agent [], int, Agent [], int, int);
+
+void warm_read(char [], Warm *);
+
+void warm_apply(Warm *, Agent [], Agent [], Real);